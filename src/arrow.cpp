@@ -0,0 +1,513 @@
+// arrow.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file reads data files in the Arrow IPC file format (Feather version
+// 2, starting with "ARROW1"), straight from the mapped file and with no
+// library. The footer at the end of the file holds the schema, a list of
+// columns (fields), and the places of the dictionary batches and record
+// batches of the file. Metadata is stored as flatbuffers: tables whose
+// fields are found through a table of offsets (vtable) stored before them.
+// Columns of strings encoded with dictionaries are read as factors, each
+// index into a dictionary becoming the level of that name, and a column of
+// doubles (or floats) is read as data values. Rows with nulls in any of
+// these columns are left out. Only uncompressed files of columns with no
+// children (no lists, structs or maps) can be read.
+//
+// By default factors are all columns encoded with dictionaries, in their
+// order, and data values are those of the last column of floating point
+// numbers; '--factors' and '--response' select other columns by name.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "data.h"
+#include "binary.h"
+
+using namespace std;
+
+#define ARROWNULL    1		// Types of columns (Type in Schema.fbs)...
+#define ARROWINT     2
+#define ARROWFLOAT   3
+#define ARROWBINARY  4
+#define ARROWUTF8    5
+#define ARROWBOOL    6
+#define ARROWDECIMAL 7
+#define ARROWDATE    8
+#define ARROWTIME    9
+#define ARROWSTAMP   10
+#define ARROWPERIOD  11
+#define ARROWFIXED   15
+#define ARROWLAPSE   18
+#define ARROWBIGBIN  19		// ...with 64 bit offsets
+#define ARROWBIGUTF8 20
+
+#define ARROWSCHEMA      1	// Types of messages (MessageHeader)
+#define ARROWDICTIONARY  2
+#define ARROWBATCH       3
+
+// The mapped file, and whether any offset read pointed out of it
+
+struct arrowfile{
+ const char *s,*e;
+ bool       bad;
+};
+
+// A column of the schema, and the buffers of its values in a batch
+
+struct arrowcol{
+ string_view name;
+ int         type;
+ int         width;		// Bytes of indexes, or of floating point values
+ bool        is_signed;
+ long long   dict;		// Id of its dictionary, or -1
+ int         buffers;		// Buffers of each batch
+ int         first;		// First buffer of the column in a batch
+ const char  *valid;		// Bitmap of rows which are not null, or NULL
+ const char  *values;
+};
+
+// A dictionary: the strings of its entries, in the mapped file
+
+struct arrowdict{
+ long long           id;
+ int                 type;
+ vector<string_view> names;
+};
+
+//------------------------------------------------------------------------//
+// Floating point numbers of 'bytes' bytes from the mapped file           //
+//------------------------------------------------------------------------//
+
+static inline double get_float(const char *p, int bytes)
+{
+ uint32_t w;
+ float    f;
+
+ if(bytes==4){
+  w=get_le(p,4);
+  memcpy(&f,&w,4);
+  return f;
+ }
+ return get_double(p);
+}
+
+//------------------------------------------------------------------------//
+// This function returns 'p' if 'n' bytes from 'p' are in the file, or    //
+// NULL, marking the file as invalid.                                     //
+//------------------------------------------------------------------------//
+
+static const char *fb_check(arrowfile *a, const char *p, uint64_t n)
+{
+ if(!p||(p<a->s)||(p>a->e)||((uint64_t) (a->e-p)<n)){
+  a->bad=true;
+  return NULL;
+ }
+ return p;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the place of field 'slot' of the flatbuffer      //
+// table 't', or NULL if the field is not stored (it has its default).    //
+//------------------------------------------------------------------------//
+
+static const char *fb_field(arrowfile *a, const char *t, int slot)
+{
+ const char *vt;
+ int        size,off;
+
+ if(!t||!fb_check(a,t,4)) return NULL;
+ vt=t-(int32_t) get_le(t,4);
+ if(!fb_check(a,vt,4)) return NULL;
+ size=get_le(vt,2);
+ if(!fb_check(a,vt,size)||(4+2*slot+2>size)) return NULL;
+ off=get_le(vt+4+2*slot,2);
+ if(off==0) return NULL;
+ return fb_check(a,t+off,1);
+}
+
+//------------------------------------------------------------------------//
+// This function returns the integer of 'bytes' in field 'slot' of table  //
+// 't', or 'def' if it is not stored.                                     //
+//------------------------------------------------------------------------//
+
+static uint64_t fb_scalar(arrowfile *a, const char *t, int slot, int bytes, uint64_t def)
+{
+ const char *p;
+
+ p=fb_field(a,t,slot);
+ if(!p||!fb_check(a,p,bytes)) return def;
+ return get_le(p,bytes);
+}
+
+//------------------------------------------------------------------------//
+// This function returns the table, vector or string referred to by field //
+// 'slot' of table 't' (or by the offset at 'p', if 't' is NULL), or NULL //
+//------------------------------------------------------------------------//
+
+static const char *fb_ref(arrowfile *a, const char *t, int slot, const char *p=NULL)
+{
+ if(t) p=fb_field(a,t,slot);
+ if(!p||!fb_check(a,p,4)) return NULL;
+ return fb_check(a,p+get_le(p,4),4);
+}
+
+//------------------------------------------------------------------------//
+// This function returns the number of elements of vector 'v' of elements //
+// of 'size' bytes, or 0 if it is not in the file.                        //
+//------------------------------------------------------------------------//
+
+static uint32_t fb_length(arrowfile *a, const char *v, int size)
+{
+ uint32_t n;
+
+ if(!v) return 0;
+ n=get_le(v,4);
+ if(!fb_check(a,v+4,(uint64_t) n*size)) return 0;
+ return n;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the string of field 'slot' of table 't'          //
+//------------------------------------------------------------------------//
+
+static string_view fb_string(arrowfile *a, const char *t, int slot)
+{
+ const char *p;
+ uint32_t   n;
+
+ p=fb_ref(a,t,slot);
+ n=fb_length(a,p,1);
+ return p?string_view(p+4,n):string_view();
+}
+
+//------------------------------------------------------------------------//
+// This function returns the message (a RecordBatch or DictionaryBatch    //
+// table) of type 'type' of the Block struct at 'b' of the footer, and    //
+// sets 'body' and 'size' to the buffers that follow it.                  //
+//------------------------------------------------------------------------//
+
+static const char *arrow_message(arrowfile *a, const char *b, int type, const char **body, uint64_t *size)
+{
+ const char *p,*m;
+ uint64_t   off,len;
+
+ off=get_le(b,8);
+ len=get_le(b+8,4);
+ *size=get_le(b+16,8);
+ if((off>(uint64_t) (a->e-a->s))||!fb_check(a,a->s+off,len)) return NULL;
+ p=a->s+off;
+ *body=fb_check(a,p+len,*size);
+ if(len<8) return NULL;
+ if(get_le(p,4)==0xffffffff) p+=8;	// Continuation marker and length...
+ else p+=4;				// ...or length alone (older files)
+ m=fb_ref(a,NULL,0,p);
+ if(fb_scalar(a,m,1,1,0)!=(uint64_t) type) return NULL;
+ return fb_ref(a,m,2);
+}
+
+//------------------------------------------------------------------------//
+// This function returns buffer 'k' of record batch 'rb', whose body of   //
+// 'size' bytes starts at 'body', and sets 'len' to its bytes.            //
+//------------------------------------------------------------------------//
+
+static const char *arrow_buffer(arrowfile *a, const char *rb, const char *body, uint64_t size, int k, uint64_t *len)
+{
+ const char *v;
+ uint64_t   off;
+
+ v=fb_ref(a,rb,2);
+ *len=0;
+ if(!v||(k>=(int) fb_length(a,v,16))){
+  a->bad=true;
+  return NULL;
+ }
+ off=get_le(v+4+16*k,8);
+ *len=get_le(v+12+16*k,8);
+ if((off>size)||(*len>size-off)){
+  a->bad=true;
+  return NULL;
+ }
+ return body+off;
+}
+
+//------------------------------------------------------------------------//
+// This function reads the strings of a dictionary batch, 'rb', into the  //
+// dictionary 'd', after those already read if it is a delta.             //
+//------------------------------------------------------------------------//
+
+static bool arrow_names(arrowfile *a, const char *rb, const char *body, uint64_t size, arrowdict *d)
+{
+ const char *offs,*chars;
+ uint64_t   n,i,len,clen,o,o2;
+ int        w;
+
+ if(fb_field(a,rb,3)) return false;	// Compressed
+ if((d->type!=ARROWBINARY)&&(d->type!=ARROWUTF8)&&(d->type!=ARROWBIGBIN)&&(d->type!=ARROWBIGUTF8)) return false;
+ n=fb_scalar(a,rb,0,8,0);
+ w=((d->type==ARROWBIGUTF8)||(d->type==ARROWBIGBIN))?8:4;
+ offs=arrow_buffer(a,rb,body,size,1,&len);
+ chars=arrow_buffer(a,rb,body,size,2,&clen);
+ if(!offs||((n>0)&&(len<(n+1)*w))) return false;
+ for(i=0;i<n;i++){
+  o=get_le(offs+i*w,w);
+  o2=get_le(offs+(i+1)*w,w);
+  if((o>o2)||(o2>clen)) return false;
+  d->names.push_back(string_view(chars+o,o2-o));
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function tells if 'name', given in the command line, names a      //
+// column. A '*' at the end of names (random factors) is ignored.         //
+//------------------------------------------------------------------------//
+
+static bool same_name(string_view name, string_view col)
+{
+ if((name.size()>0)&&(name.back()=='*')) name.remove_suffix(1);
+ if((col.size()>0)&&(col.back()=='*')) col.remove_suffix(1);
+ return name==col;
+}
+
+//------------------------------------------------------------------------//
+// This function reads an Arrow IPC file mapped between 's' and 'e'.      //
+// Factors are set from the names of their columns and levels are named   //
+// by the dictionaries, in the order they are first used. Observations    //
+// are added to the list of partials straight from the mapped columns.    //
+//------------------------------------------------------------------------//
+
+bool data::read_arrow(const char *s, const char *e)
+{
+ arrowfile  a;
+ const char *footer,*schema,*fields,*f,*t,*enc,*blocks,*rb,*body,*nodes,*p;
+ vector<arrowcol>  cols;
+ vector<arrowdict> dicts;
+ vector<int>       fcols,codes[MAXFACTORS];
+ arrowdict  *d[MAXFACTORS];
+ arrowcol   c,*fc[MAXFACTORS],*rc;
+ uint64_t   size,rows,r,nb,len,k;
+ uint32_t   nfields,i,j;
+ const char *list,*comma;
+ string_view name;
+ char       temp[101];
+ int        nfact,fact,datacol,buffers;
+ int64_t    idx;
+ bool       ok;
+
+ if((strlen(where_clause())>0)||resp||split){
+  cerr << "Rows of Arrow data files cannot be filtered, split or read with many responses!... Exiting..." << endl;
+  return false;
+ }
+ a.s=s;
+ a.e=e;
+ a.bad=false;
+ ok=false;
+
+ // The footer, before its length and the magic number at the end
+
+ if((e-s<22)||(memcmp(e-6,"ARROW1",6)!=0)) goto bad;
+ len=get_le(e-10,4);
+ if(len>(uint64_t) (e-s-18)) goto bad;
+ footer=fb_ref(&a,NULL,0,e-10-len);
+ schema=fb_ref(&a,footer,1);
+ if(!schema||(fb_scalar(&a,schema,0,2,0)!=0)) goto bad;	// Big-endian
+ fields=fb_ref(&a,schema,1);
+ nfields=fb_length(&a,fields,4);
+
+ // Columns, their types and where their buffers are in each batch
+
+ buffers=0;
+ for(i=0;i<nfields;i++){
+  f=fb_ref(&a,NULL,0,fields+4+4*i);
+  c.name=fb_string(&a,f,0);
+  c.type=fb_scalar(&a,f,2,1,0);
+  t=fb_ref(&a,f,3);
+  enc=fb_ref(&a,f,4);
+  c.dict=-1;
+  c.width=0;
+  c.is_signed=false;
+  if(fb_length(&a,fb_ref(&a,f,5),4)>0){
+   cerr << "Column " << c.name << " of " << data_file_name() << " has children, which cannot be read!... Exiting..." << endl;
+   return false;
+  }
+  if(enc){
+   c.dict=fb_scalar(&a,enc,0,8,0);
+   t=fb_ref(&a,enc,1);
+   c.width=t?fb_scalar(&a,t,0,4,0)/8:4;
+   c.is_signed=t?(fb_scalar(&a,t,1,1,0)!=0):true;
+   c.buffers=2;
+   if((c.width!=1)&&(c.width!=2)&&(c.width!=4)&&(c.width!=8)) goto bad;
+   for(j=0;(j<dicts.size())&&(dicts[j].id!=c.dict);j++);
+   if(j==dicts.size()){
+    dicts.push_back(arrowdict());
+    dicts[j].id=c.dict;
+    dicts[j].type=c.type;
+   }
+  }
+  else switch(c.type){
+   case ARROWNULL:
+    c.buffers=0;
+    break;
+   case ARROWBINARY: case ARROWUTF8: case ARROWBIGBIN: case ARROWBIGUTF8:
+    c.buffers=3;			// Nulls, offsets and bytes
+    break;
+   case ARROWFLOAT:
+    k=fb_scalar(&a,t,0,2,0);		// Precision: half, single or double
+    c.width=(k==1)?4:(k==2)?8:0;
+    c.buffers=2;
+    break;
+   case ARROWINT: case ARROWBOOL: case ARROWDECIMAL: case ARROWDATE: case ARROWTIME:
+   case ARROWSTAMP: case ARROWPERIOD: case ARROWFIXED: case ARROWLAPSE:
+    c.buffers=2;			// Nulls and values
+    break;
+   default:
+    cerr << "Column " << c.name << " of " << data_file_name() << " has a type which cannot be read!... Exiting..." << endl;
+    return false;
+  }
+  c.first=buffers;
+  buffers+=c.buffers;
+  cols.push_back(c);
+ }
+ if(a.bad) goto bad;
+
+ // Data values, from the last column of floating point numbers...
+
+ datacol=-1;
+ for(i=0;i<nfields;i++){
+  if(strlen(response_name())>0){
+   if(same_name(response_name(),cols[i].name)) datacol=i;
+  }
+  else if((cols[i].type==ARROWFLOAT)&&(cols[i].dict<0)&&(cols[i].width>0)) datacol=i;
+ }
+ if((datacol<0)||(cols[datacol].type!=ARROWFLOAT)||(cols[datacol].dict>=0)||(cols[datacol].width==0)){
+  cerr << "No column of doubles or floats";
+  if(strlen(response_name())>0) cerr << " named " << response_name();
+  cerr << " in " << data_file_name() << "!... Exiting..." << endl;
+  return false;
+ }
+ len=(cols[datacol].name.size()>100)?100:cols[datacol].name.size();
+ memcpy(temp,cols[datacol].name.data(),len);
+ temp[len]=0;
+ set_data_name(temp);
+
+ // ...and factors, from the columns encoded with dictionaries
+
+ list=factor_list();
+ if(strlen(list)>0){
+  while(*list){
+   comma=strchr(list,',');
+   if(!comma) comma=list+strlen(list);
+   name=string_view(list,comma-list);
+   list=(*comma)?comma+1:comma;
+   if(name.size()==0) continue;
+   for(i=0;(i<nfields)&&!same_name(name,cols[i].name);i++);
+   if((i==nfields)||(cols[i].dict<0)){
+    cerr << "No column of strings encoded with a dictionary named " << name << " in " << data_file_name() << "!... Exiting..." << endl;
+    return false;
+   }
+   fcols.push_back(i);
+   if(name.back()=='*') fcols.back()=-(int) i-1;	// Random factor
+  }
+ }
+ else for(i=0;i<nfields;i++) if(cols[i].dict>=0) fcols.push_back(i);
+ nfact=fcols.size();
+ if(nfact==0){
+  cerr << "No column of strings encoded with a dictionary in " << data_file_name() << "!... Exiting..." << endl;
+  return false;
+ }
+ for(fact=0;fact<nfact;fact++){
+  i=(fcols[fact]<0)?-fcols[fact]-1:fcols[fact];
+  len=(cols[i].name.size()>100)?100:cols[i].name.size();
+  memcpy(temp,cols[i].name.data(),len);
+  temp[len]=0;
+  if(!set_factor(temp)) return false;
+  if(fcols[fact]<0) set_factor_type(get_factors()-1,RANDOM);
+  fc[fact]=&cols[i];
+  for(j=0;dicts[j].id!=cols[i].dict;j++);
+  d[fact]=&dicts[j];
+ }
+ rc=&cols[datacol];
+
+ // Dictionaries, appended to in the order of the file if they are deltas
+
+ blocks=fb_ref(&a,footer,2);
+ nb=fb_length(&a,blocks,24);
+ for(k=0;k<nb;k++){
+  rb=arrow_message(&a,blocks+4+24*k,ARROWDICTIONARY,&body,&size);
+  if(!rb) goto bad;
+  idx=fb_scalar(&a,rb,0,8,0);
+  for(j=0;(j<dicts.size())&&(dicts[j].id!=idx);j++);
+  if(j==dicts.size()) continue;				// Not used by any column
+  if(fb_scalar(&a,rb,2,1,0)==0) dicts[j].names.clear();	// Not a delta
+  if(!arrow_names(&a,fb_ref(&a,rb,1),body,size,&dicts[j])) goto bad;
+ }
+ for(fact=0;fact<nfact;fact++) codes[fact].assign(d[fact]->names.size(),-1);
+
+ // Record batches
+
+ blocks=fb_ref(&a,footer,3);
+ nb=fb_length(&a,blocks,24);
+ for(k=0;k<nb;k++){
+  rb=arrow_message(&a,blocks+4+24*k,ARROWBATCH,&body,&size);
+  if(!rb||fb_field(&a,rb,3)) goto bad;		// Compressed
+  rows=fb_scalar(&a,rb,0,8,0);
+  nodes=fb_ref(&a,rb,1);
+  if(fb_length(&a,nodes,16)<nfields) goto bad;
+  for(i=0;i<nfields;i++){
+   if((cols[i].dict<0)&&(i!=(uint32_t) datacol)) continue;
+   p=nodes+4+16*i;
+   if(get_le(p,8)<rows) goto bad;
+   cols[i].valid=arrow_buffer(&a,rb,body,size,cols[i].first,&len);
+   if((get_le(p+8,8)==0)||(len==0)) cols[i].valid=NULL;	// No nulls
+   else if(len<(rows+7)/8) goto bad;
+   cols[i].values=arrow_buffer(&a,rb,body,size,cols[i].first+1,&len);
+   if(len<rows*cols[i].width) goto bad;
+  }
+  if(a.bad) goto bad;
+  for(r=0;r<rows;r++){
+   for(fact=0;fact<nfact;fact++){
+    if(fc[fact]->valid&&!((fc[fact]->valid[r>>3]>>(r&7))&1)) break;
+    idx=get_le(fc[fact]->values+r*fc[fact]->width,fc[fact]->width);
+    if(fc[fact]->is_signed&&(fc[fact]->width<8)&&(idx>>(8*fc[fact]->width-1))) idx-=(int64_t) 1<<(8*fc[fact]->width);
+    if((idx<0)||((uint64_t) idx>=codes[fact].size())) goto bad;
+    if(codes[fact][idx]<0) codes[fact][idx]=set_code(fact,d[fact]->names[idx]);
+    code_line[fact]=codes[fact][idx];
+   }
+   if((fact<nfact)||(rc->valid&&!((rc->valid[r>>3]>>(r&7))&1))){
+    memset(code_line,0,sizeof(code_line));		// A row with nulls
+    continue;
+   }
+   if(!add_value(nfact,get_float(rc->values+r*rc->width,rc->width),r)) return false;
+  }
+ }
+ if(nbatch) flush_batch();
+ ok=true;
+
+ bad:
+ if(!ok) cerr << "Invalid Arrow data file " << data_file_name() << "!... Exiting..." << endl;
+ return ok;
+}
+
+#endif
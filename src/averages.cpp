@@ -66,6 +66,14 @@ void data::compare(int fact, int total, double err, int dferr, partial *pfirst,
      else{
       t=fabs(a1-a2);
       t=t/sqrt(err/t1->n);
+      #ifndef CGI
+      // In a batch, Q is compared with a critical value shared by all
+      // analyses; only whether p is above alpha matters
+      if(strlen(batch_file_name())>0){
+       p=(t<qcritical(get_mtest()==SNK?range:total,dferr,get_alpha()))?1:0;
+      }
+      else
+      #endif
       switch(get_mtest()){
        case SNK: p=qprob(t,range,dferr); break;
        case TUKEY: p=qprob(t,total,dferr);  break;
@@ -181,7 +189,7 @@ void data::compare(int fact, int total, double err, int dferr, partial *pfirst,
 
 void data::multi_comp(CODES cline, int fact, const char *fname, double err, int dferr, partial *firstp){
  partial *t,*p,*pfirst,*plast;
- CODES cl;
+ LEVCODES cl;
  combins *firstc,*lastc,*c;
  bool    equal,found;
  int 	 i,npartials;
@@ -204,7 +212,7 @@ void data::multi_comp(CODES cline, int fact, const char *fname, double err, int
    //if(found){
     if(!firstc){ // First combination of factors
      c = new combins;      
-     memcpy(c->codes,cl,MAXFACTORS);     
+     memcpy(c->codes,cl,sizeof(LEVCODES));
      c->next=NULL;
      firstc=c;
      lastc=c;     
@@ -214,13 +222,13 @@ void data::multi_comp(CODES cline, int fact, const char *fname, double err, int
      c=firstc;
      equal=false;
      do{   
-      if(memcmp(cl,c->codes,MAXFACTORS)==0) equal=true;
+      if(memcmp(cl,c->codes,sizeof(LEVCODES))==0) equal=true;
       c=c->next;
      }while((c)&&(!equal));
       
      if(!equal){
       c=new combins;
-      memcpy(c->codes,cl,MAXFACTORS);
+      memcpy(c->codes,cl,sizeof(LEVCODES));
       lastc->next=c;
       lastc=c;   
       c->next=NULL;
@@ -239,14 +247,14 @@ void data::multi_comp(CODES cline, int fact, const char *fname, double err, int
    do{
     t=firstp;
     do{
-     memcpy(cl,t->codes,MAXFACTORS);
+     memcpy(cl,t->codes,sizeof(LEVCODES));
      cl[fact]=0;
-     if(memcmp(cl,c->codes,MAXFACTORS)==0){
+     if(memcmp(cl,c->codes,sizeof(LEVCODES))==0){
       // This is a partial that should be added
       if(!pfirst){
        p = new partial;
        npartials=1;
-       memcpy(p->codes,t->codes,MAXFACTORS);
+       memcpy(p->codes,t->codes,sizeof(LEVCODES));
        p->sum=t->sum;
        p->n=t->n;
        pfirst=p;
@@ -257,7 +265,7 @@ void data::multi_comp(CODES cline, int fact, const char *fname, double err, int
       else{
        p = new partial;
        npartials++;
-       memcpy(p->codes,t->codes,MAXFACTORS);
+       memcpy(p->codes,t->codes,sizeof(LEVCODES));
        p->sum=t->sum;
        p->n=t->n;
        plast->next=p;
@@ -474,18 +482,18 @@ void data::get_averages(CODES cline, const char *fname, double err, int dferr, d
      t=p->next;
      do{
       if((p->sum/p->n)>(t->sum/t->n)){
-       memcpy(q.codes,p->codes,MAXFACTORS);
-       memcpy(q.orig,p->orig,MAXFACTORS);
+       memcpy(q.codes,p->codes,sizeof(LEVCODES));
+       memcpy(q.orig,p->orig,sizeof(LEVCODES));
        q.sum=p->sum;
        //q.sum2=p->sum2;
        q.n=p->n;
-       memcpy(p->codes,t->codes,MAXFACTORS);
-       memcpy(p->orig,t->orig,MAXFACTORS);
+       memcpy(p->codes,t->codes,sizeof(LEVCODES));
+       memcpy(p->orig,t->orig,sizeof(LEVCODES));
        p->sum=t->sum;
        //p->sum2=t->sum2;
        p->n=t->n;
-       memcpy(t->codes,q.codes,MAXFACTORS);
-       memcpy(t->orig,q.orig,MAXFACTORS);
+       memcpy(t->codes,q.codes,sizeof(LEVCODES));
+       memcpy(t->orig,q.orig,sizeof(LEVCODES));
        t->sum=q.sum;
        //t->sum2=q.sum2;
        t->n=q.n;
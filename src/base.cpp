@@ -26,6 +26,10 @@
 #include <iomanip>
 #include <cstring>
 #include <cstdlib>
+#ifndef CGI
+#include <glob.h>
+#include <thread>
+#endif
 
 #include "base.h"
 #include "../config.h"
@@ -49,8 +53,32 @@ base::base()
  memset(buffer,0,sizeof(buffer));
  #else
  do_debug=false;		// Debug - very verbose mode
+ pipelined=false;		// Parse and summarize data in separate threads
+ comparetransf=false;		// Compare transformations instead of an anova
+ appending=false;		// Add new rows of the data file to the snapshot
+ summarized=false;		// Data files hold statistics of cells (if not detected)
+ strcpy(convertfilename,"");	// Binary file to convert data file into
+ datafiles=NULL;		// List of data files
+ ndatafiles=0;
+ factorlist="";			// Columns to read as factors
+ responsename="";		// Column to read as data values
+ whereclause="";		// Predicates rows must satisfy
+ snapshotname="";		// Snapshot of summarized data
+ splitname="";			// Analyse all rows together
+ batchname="";			// A single analysis
+ batchext="";			// Batch results in a single stream
+ shardname="";			// Analyse the data, instead of writing a shard
+ merging=false;			// Data files hold observations
+ followrows=0;			// Do not follow the data file
+ followsecs=0;
+ windowrows=0;			// Analyse all rows followed
+ windowsecs=0;
+ responsecols=0;		// A single response
+ memlimit=0;			// Keep all cells in memory
+ fdr=false;			// Do not adjust P values of many responses
  #endif
  mtests=NOMTESTS;		// Show multiple tests
+ nthreads=0;			// Threads used to read data files (0 if not given)
  pretransf=NOTRANSF;		// Pre-transformation
  transf=NOTRANSF;		// Apply transformation to data 
  alpha=0.05;
@@ -70,6 +98,16 @@ bool base::debug()
 {
  return do_debug;
 }
+
+bool base::pipeline()
+{
+ return pipelined;
+}
+
+bool base::compare_transforms()
+{
+ return comparetransf;
+}
 #endif
   
 bool base::do_anova()
@@ -97,6 +135,29 @@ int  base::get_mtest()
  return mtests;
 }
 
+int  base::threads()
+{
+ return nthreads;
+}
+
+#ifndef CGI
+//------------------------------------------------------------------------//
+// This function returns the threads used for 'tasks' tasks run apart     //
+// (data files, groups of rows or jobs of a batch): those given with      //
+// '--threads' or, if it was not given, one for each processor, but no    //
+// more than tasks.                                                       //
+//------------------------------------------------------------------------//
+
+int  base::workers(int tasks)
+{
+ int n;
+
+ n=(nthreads>0)?nthreads:(int) thread::hardware_concurrency();
+ if(n>tasks) n=tasks;
+ return (n<1)?1:n;
+}
+#endif
+
 bool base::show_ctrules()
 {
  return ctrules;
@@ -129,6 +190,156 @@ const char *base::data_file_name()
  return datafilename;
 }
 
+#ifndef CGI
+const char *base::convert_file_name()
+{
+ return convertfilename;
+}
+
+int base::data_files()
+{
+ return ndatafiles;
+}
+
+// Makes data file 'k' of the list the data file to read
+
+void base::set_data_file(int k)
+{
+ if((k>=0)&&(k<ndatafiles)){
+  strncpy(datafilename,datafiles[k],sizeof(datafilename)-1);
+  datafilename[sizeof(datafilename)-1]=0;
+ }
+}
+
+// Adds 'name' to the list of data files. Names with wildcards are expanded
+// and replaced by the files they match, in alphabetical order. The list
+// is shared by all copies of this object, and lasts as long as the program.
+
+void base::add_data_file(const char *name)
+{
+ const char **d;
+ glob_t     g;
+ size_t     i,n;
+ 
+ n=1;
+ memset(&g,0,sizeof(g));
+ if(strpbrk(name,"*?[")&&(glob(name,0,NULL,&g)==0)) n=g.gl_pathc;
+ d = new const char*[ndatafiles+n];
+ if(datafiles){
+  memcpy(d,datafiles,ndatafiles*sizeof(const char *));
+  delete [] datafiles;
+ }
+ datafiles=d;
+ if(g.gl_pathc>0){
+  for(i=0;i<n;i++) datafiles[ndatafiles++]=strdup(g.gl_pathv[i]);
+ }
+ else datafiles[ndatafiles++]=name;
+ globfree(&g);
+ set_data_file(0);
+}
+
+const char *base::factor_list()
+{
+ return factorlist;
+}
+
+const char *base::response_name()
+{
+ return responsename;
+}
+
+const char *base::where_clause()
+{
+ return whereclause;
+}
+
+const char *base::split_by()
+{
+ return splitname;
+}
+
+const char *base::batch_file_name()
+{
+ return batchname;
+}
+
+const char *base::batch_extension()
+{
+ return batchext;
+}
+
+const char *base::shard_file_name()
+{
+ return shardname;
+}
+
+bool base::merge_shards()
+{
+ return merging;
+}
+
+bool base::projected()
+{
+ return (strlen(factorlist)>0)||(strlen(responsename)>0)||(strlen(whereclause)>0)||(responsecols>0)||
+        (strlen(splitname)>0);
+}
+
+const char *base::snapshot_file_name()
+{
+ return snapshotname;
+}
+
+bool base::append_rows()
+{
+ return appending;
+}
+
+bool base::summary_data()
+{
+ return summarized;
+}
+
+bool base::following()
+{
+ return followrows>0;
+}
+
+int base::follow_rows()
+{
+ return followrows;
+}
+
+int base::follow_seconds()
+{
+ return followsecs;
+}
+
+int base::window_rows()
+{
+ return windowrows;
+}
+
+int base::window_seconds()
+{
+ return windowsecs;
+}
+
+int base::response_columns()
+{
+ return responsecols;
+}
+
+long base::mem_limit()
+{
+ return memlimit;
+}
+
+bool base::adjust_fdr()
+{
+ return fdr;
+}
+#endif
+
 #ifdef CGI
 void base::set_option(const char *option, int type)
 {
@@ -217,11 +428,10 @@ void base::parse_args(int argc, char *argv[])
     case 'd': do_debug=true; i++; break;       // debuggin info
     case 'h': homogeneity=true; i++; break;    // show homogeneity tests
     case 'o': orthogonal=true; i++; break;     // show orthogonal model
-    case 'f': i++;                             // data file name
+    case 'f': i++;                             // data file names
               if((i<argc)&&(argv[i][0]!='-')){
-               strcpy(datafilename,argv[i]);
+               while((i<argc)&&(argv[i][0]!='-')) add_data_file(argv[i++]);
 	       InputFileExists=true;            
-	       i++;
 	      }
 	      else noanova=true;  
 	      break;
@@ -281,6 +491,118 @@ void base::parse_args(int argc, char *argv[])
 	       i++;
 	      } 
 	      break;	      
+    case '-': if(strcmp(argv[i],"--threads")==0){ // threads to read data
+               i++;
+               if((i<argc)&&(argv[i][0]!='-')){
+                nthreads=atoi(argv[i]);
+                if(nthreads<1) nthreads=1;
+                i++;
+               }
+              }
+              else if(strcmp(argv[i],"--convert")==0){ // text to binary
+               i++;
+               if((i+1<argc)&&(argv[i][0]!='-')&&(argv[i+1][0]!='-')){
+                strncpy(datafilename,argv[i],sizeof(datafilename)-1);
+                datafilename[sizeof(datafilename)-1]=0;
+                strncpy(convertfilename,argv[i+1],sizeof(convertfilename)-1);
+                convertfilename[sizeof(convertfilename)-1]=0;
+                i+=2;
+               }
+              }
+              else if(strcmp(argv[i],"--factors")==0){ // factor columns
+               i++;
+               if((i<argc)&&(argv[i][0]!='-')) factorlist=argv[i++];
+              }
+              else if(strcmp(argv[i],"--response")==0){ // data column
+               i++;
+               if((i<argc)&&(argv[i][0]!='-')) responsename=argv[i++];
+              }
+              else if(strcmp(argv[i],"--pipeline")==0){ // parse and summarize
+               pipelined=true;                          // in two threads
+               i++;
+              }
+              else if(strcmp(argv[i],"--transforms")==0){ // compare
+               comparetransf=true;                        // transformations
+               i++;
+              }
+              else if(strcmp(argv[i],"--snapshot")==0){ // summarized data
+               i++;
+               if((i<argc)&&(argv[i][0]!='-')) snapshotname=argv[i++];
+              }
+              else if(strcmp(argv[i],"--follow")==0){ // growing data file
+               i++;
+               followrows=1000;
+               followsecs=5;
+               if((i<argc)&&(argv[i][0]!='-')){
+                followrows=atoi(argv[i++]);
+                if(followrows<1) followrows=1;
+                if((i<argc)&&(argv[i][0]!='-')){
+                 followsecs=atoi(argv[i++]);
+                 if(followsecs<1) followsecs=1;
+                }
+               }
+              }
+              else if(strcmp(argv[i],"--window")==0){ // last rows or seconds
+               i++;
+               if((i<argc)&&(argv[i][0]!='-')){
+                if(argv[i][strlen(argv[i])-1]=='s') windowsecs=atoi(argv[i]);
+                else windowrows=atoi(argv[i]);
+                i++;
+               }
+              }
+              else if(strcmp(argv[i],"--responses")==0){ // many trailing
+               i++;                                     // data columns
+               if((i<argc)&&(argv[i][0]!='-')){
+                responsecols=atoi(argv[i++]);
+                if(responsecols<1) responsecols=1;
+               }
+              }
+              else if(strcmp(argv[i],"--mem-limit")==0){ // cells on disk
+               i++;                                      // beyond it
+               if((i<argc)&&(argv[i][0]!='-')){
+                memlimit=atol(argv[i++]);
+                if(memlimit<1) memlimit=1;
+                memlimit*=1048576;
+               }
+              }
+              else if(strcmp(argv[i],"--fdr")==0){ // Benjamini-Hochberg
+               fdr=true;
+               i++;
+              }
+              else if(strcmp(argv[i],"--append")==0){ // new rows only
+               appending=true;
+               i++;
+              }
+              else if(strcmp(argv[i],"--summary")==0){ // statistics of cells
+               summarized=true;
+               i++;
+              }
+              else if(strcmp(argv[i],"--split-by")==0){ // an anova per
+               i++;                                    // group of rows
+               if((i<argc)&&(argv[i][0]!='-')) splitname=argv[i++];
+              }
+              else if(strcmp(argv[i],"--batch")==0){ // many data files
+               i++;                                 // in one run
+               if((i<argc)&&(argv[i][0]!='-')){
+                batchname=argv[i++];
+                if((i<argc)&&(argv[i][0]!='-')) batchext=argv[i++];
+               }
+              }
+              else if(strcmp(argv[i],"--shard")==0){ // summarized data
+               i++;                                 // to merge later
+               if((i<argc)&&(argv[i][0]!='-')) shardname=argv[i++];
+              }
+              else if(strcmp(argv[i],"--merge")==0){ // shards instead
+               i++;                                 // of data files
+               while((i<argc)&&(argv[i][0]!='-')) add_data_file(argv[i++]);
+               merging=true;
+              }
+              else if(strcmp(argv[i],"--where")==0){ // row filter
+               i++;
+               if(i<argc) whereclause=argv[i++];
+              }
+              else i++;
+              break;
     default: i++; break;	      
    } 
   }
@@ -297,6 +619,7 @@ void base::help()
  cout << "See the COPYING file for details" << endl << endl;
  cout << "Program usage:" << endl;
  cout << "  mwanova -f DataFile [options]" << endl;
+ cout << "  mwanova -f DataFile DataFile... [options]" << endl;
  cout << "  cat DataFile | mwanova -f [options]" << endl << endl;
  cout << "OPTIONS:" << endl;
  cout << "  -x  output means table      -n  do not output anova table" << endl;
@@ -307,6 +630,38 @@ void base::help()
  cout << "  -t sqrt|log|ln|arcsin|asin|mult|div  transform data " << endl;
  cout << "  -m snk|tukey                         multiple comparison tests" << endl;
  cout << "  -a <alpha> [default 0.05]            alpha for multiple tests" << endl;
+ cout << "  --threads <n> [default 1]            threads used to read a data file; several" << endl;
+ cout << "                                       files, groups or jobs of a batch use one" << endl;
+ cout << "                                       per processor if not given" << endl;
+ cout << "  --pipeline                           parse and summarize data in two threads" << endl;
+ cout << "  --convert <DataFile> <BinaryFile>    convert data file to binary format" << endl;
+ cout << "  --factors <Name,Name*,...>           columns to read as factors" << endl;
+ cout << "  --response <Name>                    column to read as data values" << endl;
+ cout << "  --summary                            data files hold n and sum and sumsq, or n" << endl;
+ cout << "                                       and mean and var, of each cell" << endl;
+ cout << "  --where <Predicates>                 read only rows satisfying predicates," << endl;
+ cout << "                                       e.g. \"Year in (2019,2020) and Zone != C\"" << endl;
+ cout << "  --split-by <Name>                    a separate analysis for each value of a column" << endl;
+ cout << "  --batch <Manifest> [<Extension>]     analyse the data files of a manifest, one" << endl;
+ cout << "                                       per line followed by its options, in one run;" << endl;
+ cout << "                                       with an extension, results go to DataFileExtension" << endl;
+ cout << "  --shard <ShardFile>                  write the summarized data to a shard, instead" << endl;
+ cout << "                                       of analysing it" << endl;
+ cout << "  --merge <ShardFile> <ShardFile>...   analyse the data of shards, merged exactly" << endl;
+ cout << "  --snapshot <SnapshotFile>            keep summarized data for later runs" << endl;
+ cout << "  --append                             add new rows of the data file to the snapshot" << endl;
+ cout << "  --follow [<rows> [<seconds>]]        keep reading a growing data file and rerun" << endl;
+ cout << "                                       the analysis every 1000 rows or 5 seconds" << endl;
+ cout << "  --window <rows>|<seconds>s           with --follow, analyse only the last rows" << endl;
+ cout << "                                       or those read in the last seconds" << endl;
+ cout << "  --mem-limit <MB>                     keep cells on disk beyond this memory," << endl;
+ cout << "                                       for designs with too many cells" << endl;
+ cout << "  --transforms                         compare homogeneity of variances under" << endl;
+ cout << "                                       all transformations, in a single pass" << endl;
+ cout << "  --responses <n>                      analyse the last n columns as responses," << endl;
+ cout << "                                       one row per response and term" << endl;
+ cout << "  --fdr                                with --responses, adjust P values for the" << endl;
+ cout << "                                       false discovery rate (Benjamini-Hochberg)" << endl;
  cout << endl;
  cout << "Read the man page for more information" << endl;
 }
@@ -30,6 +30,25 @@
 class base{
  private:
   char datafilename[200];
+  #ifndef CGI
+  char convertfilename[200];
+  const char **datafiles;	// Data files given with '-f'
+  int  ndatafiles;
+  const char *factorlist;
+  const char *responsename;
+  const char *whereclause;
+  const char *snapshotname;
+  const char *splitname;	// Column whose values split rows into groups
+  const char *batchname;	// Manifest of data files analysed in a batch
+  const char *batchext;		// Extension of their output files, if any
+  const char *shardname;	// Shard of summarized data to write
+  int  followrows;		// Refresh the analysis every 'followrows' rows...
+  int  followsecs;		// ...or 'followsecs' seconds, with '--follow'
+  int  windowrows;		// Analyse only the last 'windowrows' rows...
+  int  windowsecs;		// ...or those of the last 'windowsecs' seconds
+  int  responsecols;		// Trailing columns read as responses
+  long memlimit;		// Bytes of cells kept in memory while reading
+  #endif
   #ifdef CGI
   char buffer[MAXBUFF];
   #endif
@@ -42,11 +61,18 @@ class base{
   bool homogeneity;
   #ifndef CGI
   bool do_debug;
+  bool pipelined;
+  bool comparetransf;
+  bool appending;
+  bool summarized;		// Data files hold statistics of cells
+  bool fdr;
+  bool merging;			// Data files are shards to merge
   #endif
   
   int  transf;
   int  pretransf;  
   int  mtests;
+  int  nthreads;
   
   double alpha;
    
@@ -56,6 +82,9 @@ class base{
   
   #ifndef CGI
   bool debug();
+  bool pipeline();
+  bool compare_transforms();
+  int  workers(int);
   #endif
   
   bool be_verbose();  
@@ -64,6 +93,7 @@ class base{
   int  pretransform();
   int  transformation();
   int  get_mtest();
+  int  threads();
   bool show_ctrules();
   bool show_mtable();  
   bool show_mtests();
@@ -71,9 +101,35 @@ class base{
   
   
   const char *data_file_name();
+  #ifndef CGI
+  const char *convert_file_name();
+  int  data_files();
+  void set_data_file(int);
+  const char *factor_list();
+  const char *response_name();
+  const char *where_clause();
+  const char *split_by();
+  const char *batch_file_name();
+  const char *batch_extension();
+  const char *shard_file_name();
+  bool merge_shards();
+  bool projected();
+  const char *snapshot_file_name();
+  bool append_rows();
+  bool summary_data();
+  bool following();
+  int  follow_rows();
+  int  follow_seconds();
+  int  window_rows();
+  int  window_seconds();
+  int  response_columns();
+  long mem_limit();
+  bool adjust_fdr();
+  #endif
   
   #ifndef CGI
   void parse_args(int argc, char *argv[]);
+  void add_data_file(const char *);
   void help();
   #else
   void set_option(const char *, int );
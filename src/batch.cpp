@@ -0,0 +1,267 @@
+// batch.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file analyses many data files in a single run ('--batch'). Each line
+// of the manifest names a data file followed by its own options, as they
+// would follow '-f' in the command line, and options of the command line
+// apply to all of them. Each data file gets its own model: a pool of
+// threads reads the data files and fits their models, since this writes
+// nothing, while results are written in turn, in the order of the manifest,
+// either to a single stream or to a file for each data file. Only a few
+// models are kept ahead of the one being written, so memory does not grow
+// with the length of the manifest. Critical values of multiple tests are
+// shared by all models (see qcritical).
+
+#ifndef CGI
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "model.h"
+
+using namespace std;
+
+#define BATCHAHEAD  2		// Models kept per thread ahead of the output
+
+// An analysis of the manifest: its line split into arguments, its model
+// and whether its data was read and the model fitted
+
+struct job{
+ char  *line;
+ char  **argv;
+ int   argc;
+ model *m;
+ bool  read;
+ bool  fitted;
+ bool  done;
+};
+
+//------------------------------------------------------------------------//
+// This function splits the 'line' of a manifest into the arguments of a  //
+// job, in place, as a shell would: words are separated by blanks unless  //
+// quoted. The data file is preceded by '-f'. It returns the number of    //
+// arguments, 0 for blank lines and comments ('#').                       //
+//------------------------------------------------------------------------//
+
+static int split_line(char *line, char **argv)
+{
+ char *s,*d,quote;
+ int  argc;
+
+ s=line;
+ while((*s==' ')||(*s=='\t')) s++;
+ if((*s==0)||(*s=='#')) return 0;
+ argv[0]=(char *) "mwanova";
+ argv[1]=(char *) "-f";
+ argc=2;
+ while(*s){
+  while((*s==' ')||(*s=='\t')) s++;
+  if(*s==0) break;
+  argv[argc++]=d=s;
+  quote=0;
+  while(*s&&(quote||((*s!=' ')&&(*s!='\t')))){
+   if(quote&&(*s==quote)) quote=0;
+   else if(!quote&&((*s=='"')||(*s=='\''))) quote=*s;
+   else *d++=*s;
+   s++;
+  }
+  if(*s) s++;
+  *d=0;
+ }
+ return argc;
+}
+
+//------------------------------------------------------------------------//
+// This function reads the manifest into a list of jobs. It returns the   //
+// number of jobs, or -1 if the manifest cannot be read.                  //
+//------------------------------------------------------------------------//
+
+static int read_manifest(const char *name, job **jobs)
+{
+ ifstream in(name);
+ string   s;
+ job      *j;
+ int      n,max;
+
+ *jobs=NULL;
+ if(!in) return -1;
+ n=max=0;
+ while(getline(in,s)){
+  if(!s.empty()&&(s.back()=='\r')) s.pop_back();
+  if(n==max){
+   max=(max>0)?2*max:64;
+   j = new job[max];
+   if(*jobs){
+    memcpy(j,*jobs,n*sizeof(job));
+    delete [] *jobs;
+   }
+   *jobs=j;
+  }
+  j=&(*jobs)[n];
+  memset(j,0,sizeof(job));
+  j->line=strdup(s.c_str());
+  j->argv = new char*[s.size()/2+4];
+  j->argc=split_line(j->line,j->argv);
+  if(j->argc>2) n++;
+  else{
+   delete [] j->argv;
+   free(j->line);
+  }
+ }
+ return n;
+}
+
+//------------------------------------------------------------------------//
+// This function reads the data file of job 'j' into a new model, with    //
+// the options of its line, and fits the model, unless it is made of      //
+// groups of rows, whose models are fitted on their own.                  //
+//------------------------------------------------------------------------//
+
+void model::read_job(job *j)
+{
+ j->m = new model;
+ *(base *) j->m=*(base *) this;
+ j->m->parse_args(j->argc,j->argv);
+ if((strlen(j->m->convert_file_name())>0)||j->m->following()||j->m->be_verbose()){
+  cerr << "Data files of a batch cannot be converted, followed or read verbosely (" << j->argv[2] << ")!" << endl;
+  return;
+ }
+ j->read=j->m->read_data();
+ if(j->read&&!j->m->compare_transforms()&&(j->m->get_groups()==0)) j->fitted=j->m->fit();
+}
+
+//------------------------------------------------------------------------//
+// This function analyses the data files of the manifest given with       //
+// '--batch', in up to 'workers()' threads (or as many as there are       //
+// processors if '--threads' is not given), and writes their results in   //
+// the order of the manifest: to files named as their data files, plus    //
+// the extension of '--batch', or to the standard output, each after a    //
+// header with the name of its data file.                                 //
+//------------------------------------------------------------------------//
+
+void model::batch()
+{
+ job          *jobs,*j;
+ thread       *th;
+ mutex        lock;
+ condition_variable cv;
+ ofstream     out;
+ streambuf    *console;
+ ostream      *tied;
+ char         h[ROWSIZE+1];
+ int          njobs,nthreads,next,written,k,i;
+ ios::fmtflags flags;
+ streamsize   prec;
+
+ if((data_files()>0)||be_verbose()){
+  cerr << "Data files of a batch are given in its manifest, and cannot be read verbosely!... Exiting..." << endl;
+  return;
+ }
+ njobs=read_manifest(batch_file_name(),&jobs);
+ if(njobs<0){
+  cerr << "Error while opening " << batch_file_name() << "!... Exiting..." << endl;
+  return;
+ }
+ if(njobs==0){
+  if(jobs) delete [] jobs;		// Only lines without data files
+  return;
+ }
+ nthreads=workers(njobs);
+
+ // Threads take jobs in order, but no further than BATCHAHEAD per thread
+ // beyond the one being written
+
+ next=written=0;
+ tied=cerr.tie(NULL);			// Errors of threads do not flush cout
+ th = new thread[nthreads];
+ for(i=0;i<nthreads;i++){
+  th[i]=thread([=,&next,&written,&lock,&cv]{
+   int k;
+   for(;;){
+    {
+     unique_lock<mutex> l(lock);
+     cv.wait(l,[&]{ return (next>=njobs)||(next<written+BATCHAHEAD*nthreads); });
+     if(next>=njobs) return;
+     k=next++;
+    }
+    read_job(&jobs[k]);
+    {
+     lock_guard<mutex> l(lock);
+     jobs[k].done=true;
+    }
+    cv.notify_all();
+   }
+  });
+ }
+
+ flags=cout.flags();			// Each data file formats output anew
+ prec=cout.precision();
+ for(k=0;k<njobs;k++){
+  j=&jobs[k];
+  {
+   unique_lock<mutex> l(lock);
+   cv.wait(l,[&]{ return j->done; });
+  }
+  console=NULL;
+  if(strlen(batch_extension())>0){
+   out.open(string(j->argv[2])+batch_extension());
+   if(out) console=cout.rdbuf(out.rdbuf());
+   else cerr << "Error while opening " << j->argv[2] << batch_extension() << "!..." << endl;
+  }
+  else{
+   snprintf(h,sizeof(h)," %s ",j->argv[2]);
+   header(h);
+  }
+  if((strlen(batch_extension())==0)||console){
+   if(j->read){
+    if(j->m->compare_transforms()) j->m->report_candidates();
+    else if(j->m->get_groups()>0) j->m->run_groups();
+    else if(j->fitted) j->m->report();
+   }
+  }
+  cout.flags(flags);
+  cout.precision(prec);
+  if(console){
+   cout.rdbuf(console);
+   out.close();
+  }
+  out.clear();
+  delete j->m;
+  delete [] j->argv;
+  free(j->line);
+  {
+   lock_guard<mutex> l(lock);
+   written=k+1;
+  }
+  cv.notify_all();
+ }
+ for(i=0;i<nthreads;i++) th[i].join();
+ cerr.tie(tied);
+ delete [] th;
+ delete [] jobs;
+}
+
+#endif
@@ -0,0 +1,617 @@
+// binary.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file reads and writes binary data files (.mwb). These hold the same
+// information of a text data file, but factor levels are dictionary encoded
+// and data is stored by columns, so they can be read with a single mmap and
+// no string handling at all. All integers are unsigned and little-endian,
+// and data values are IEEE 754 doubles, also little-endian:
+//
+//   "MWB1"                     magic number (4 bytes)
+//   uint32  version            currently 1
+//   uint32  factors            number of factors
+//   uint64  rows               number of observations
+//   for each factor:
+//     uint8   type             0 - fixed, 1 - random
+//     uint8   width            bytes of each level code: 1, 2 or 4
+//     uint16  length, bytes    name of the factor
+//     uint32  levels           number of levels
+//     for each level:
+//       uint16  length, bytes  name of the level
+//   uint16  length, bytes      name of the data variable
+//
+// After the header, padded with zeros to a multiple of 8 bytes, there is
+// one column of level codes (indexes into the list of levels) per factor,
+// each also padded to a multiple of 8 bytes, and a column of 'rows' data
+// values. Values are stored untransformed, so the options -p and -t apply
+// when a binary file is read.
+//
+// This file also reads and writes snapshots of summarized data (.mwc, with
+// '--snapshot'), which hold the sums, sums of squares and replicates of all
+// combinations of factor levels read from a data file, so later runs with
+// the same data file need not read it again:
+//
+//   "MWC1"                     magic number (4 bytes)
+//   uint32  version            currently 1
+//   uint64  key                hash of the options which change the sums
+//                              (-p, -t, --factors, --response and --where)
+//                              and of the header line of the data file
+//   uint64  consumed           bytes of the data file summarized
+//   uint64  head, tail         hashes of the first and last SNAPBYTES bytes
+//                              summarized, to detect changes in the file
+//   uint32  factors            number of factors
+//   uint32  cells              number of combinations of factor levels
+//   for each factor:
+//     uint8   type             0 - fixed, 1 - random
+//     uint8   0
+//     uint16  length, bytes    name of the factor
+//     uint32  levels           number of levels
+//     for each level:
+//       uint16  length, bytes  name of the level
+//   uint16  length, bytes      name of the data variable
+//
+// After the header, padded with zeros to a multiple of 8 bytes, there is a
+// record for each combination: its level codes (uint32 each, padded to a
+// multiple of 8 bytes), its sum and sum of squares (doubles) and its number
+// of replicates (uint64). Sums are of transformed values.
+
+#ifndef CGI
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "data.h"
+#include "binary.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------//
+// This function moves 'p' to the next multiple of 8 bytes from 's', at   //
+// which columns start. It returns false if that is beyond 'e'.           //
+//------------------------------------------------------------------------//
+
+static inline bool skip_padding(const char *s, const char *e, const char *&p)
+{
+ if((p-s)%8==0) return true;
+ if(e-p<8-(p-s)%8) return false;
+ p+=8-(p-s)%8;
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function reads a binary data file mapped between 's' and 'e'.     //
+// Factors and levels are set from the header, in the order they have in  //
+// the file, and observations are added to the list of partials straight  //
+// from the columns of level codes and data values.                       //
+//------------------------------------------------------------------------//
+
+bool data::read_binary(const char *s, const char *e)
+{
+ const char *p,*col[MAXFACTORS];
+ uint64_t   nrows,r;
+ uint32_t   nlev[MAXFACTORS],l,c;
+ int        nfact,f,type,width[MAXFACTORS],*map[MAXFACTORS];
+ int        len;
+ char       name[MAXNAME+1];
+ bool       ok;
+
+ if(projected()){
+  cerr << "Columns cannot be selected or filtered in binary data files!... Exiting..." << endl;
+  return false;
+ }
+ memset(map,0,sizeof(map));
+ ok=false;
+ p=s+4;
+ if(e-p<16) goto bad;
+ if(get_le(p,4)!=1) goto bad;
+ nfact=get_le(p+4,4);
+ nrows=get_le(p+8,8);
+ if((nfact<0)||(nfact>MAXFACTORS)) goto bad;
+ p+=16;
+
+ // Factors and their levels
+
+ for(f=0;f<nfact;f++){
+  if(e-p<4) goto bad;
+  type=(unsigned char) p[0];
+  width[f]=(unsigned char) p[1];
+  if((width[f]!=1)&&(width[f]!=2)&&(width[f]!=4)) goto bad;
+  len=get_le(p+2,2);
+  p+=4;
+  if(e-p<len+4) goto bad;
+  memcpy(name,p,len>MAXNAME?MAXNAME:len);
+  name[len>MAXNAME?MAXNAME:len]=0;
+  if(!set_factor(name)) goto bad;
+  set_factor_type(f,type==RANDOM?RANDOM:FIXED);
+  p+=len;
+  nlev[f]=get_le(p,4);
+  p+=4;
+  if(nlev[f]>(uint64_t) (e-p)/2) goto bad;	// Names take 2 bytes or more
+  map[f] = new int[nlev[f]+1];
+  for(l=0;l<nlev[f];l++){
+   if(e-p<2) goto bad;
+   len=get_le(p,2);
+   if(e-p<len+2) goto bad;
+   map[f][l]=set_code(f,string_view(p+2,len));
+   p+=len+2;
+  }
+ }
+ if(e-p<2) goto bad;
+ len=get_le(p,2);
+ if(e-p<len+2) goto bad;
+ memcpy(name,p+2,len>MAXNAME?MAXNAME:len);
+ name[len>MAXNAME?MAXNAME:len]=0;
+ set_data_name(name);
+ p+=len+2;
+
+ // Columns of level codes and data values
+
+ // Sizes are checked by dividing, since 'nrows' times the width of a
+ // column could wrap around
+
+ if(!skip_padding(s,e,p)) goto bad;
+ for(f=0;f<nfact;f++){
+  col[f]=p;
+  if(nrows>(uint64_t) (e-p)/width[f]) goto bad;
+  p+=nrows*width[f];
+  if(!skip_padding(s,e,p)) goto bad;
+ }
+ if(nrows>(uint64_t) (e-p)/8) goto bad;
+ for(r=0;r<nrows;r++){
+  for(f=0;f<nfact;f++){
+   c=get_le(col[f]+r*width[f],width[f]);
+   if(c>=nlev[f]) goto bad;
+   code_line[f]=map[f][c];
+  }
+  if(!add_value(nfact,get_double(p+r*8),r)) goto bad;
+ }
+ if(nbatch) flush_batch();
+ ok=true;
+
+ bad:
+ for(f=0;f<MAXFACTORS;f++) if(map[f]) delete [] map[f];
+ if(!ok) cerr << "Invalid binary data file " << data_file_name() << "!... Exiting..." << endl;
+ return ok;
+}
+
+//------------------------------------------------------------------------//
+// This function converts the text data file given with '--convert' into  //
+// a binary data file. The text file is read as usual, but observations   //
+// are kept, untransformed, in 'rows' instead of being summarized.        //
+//------------------------------------------------------------------------//
+
+bool data::convert()
+{
+ ofstream out;
+ uint64_t written,r;
+ int      f,l,width[MAXFACTORS];
+ rowset   rs;
+
+ rs.n=0;
+ rs.max=0;
+ rs.codes=NULL;
+ rs.values=NULL;
+ rows=&rs;
+ if(!read_data()){
+  rows=NULL;
+  return false;
+ }
+ rows=NULL;
+
+ out.open(convert_file_name(),ios::out|ios::binary|ios::trunc);
+ if(!out){
+  cerr << "Error while opening " << convert_file_name() << "!... Exiting..." << endl;
+  if(rs.codes) delete [] rs.codes;
+  if(rs.values) delete [] rs.values;
+  return false;
+ }
+
+ // Header
+
+ out.write("MWB1",4);
+ put_le(out,1,4);
+ put_le(out,get_factors(),4);
+ put_le(out,rs.n,8);
+ written=20;
+ for(f=0;f<get_factors();f++){
+  if(get_levels(f)<=0x100) width[f]=1;
+  else if(get_levels(f)<=0x10000) width[f]=2;
+  else width[f]=4;
+  put_le(out,get_factor_type(f),1);
+  put_le(out,width[f],1);
+  put_name(out,get_factor_name(f));
+  put_le(out,get_levels(f),4);
+  written+=8+strlen(get_factor_name(f));
+  for(l=0;l<get_levels(f);l++){
+   put_name(out,get_code_name(f,l));
+   written+=2+strlen(get_code_name(f,l));
+  }
+ }
+ put_name(out,data_name);
+ written+=2+strlen(data_name);
+ put_padding(out,written);
+
+ // Columns
+
+ for(f=0;f<get_factors();f++){
+  for(r=0;r<(uint64_t) rs.n;r++) put_le(out,rs.codes[r][f],width[f]);
+  put_padding(out,rs.n*width[f]);
+ }
+ for(r=0;r<(uint64_t) rs.n;r++) put_double(out,rs.values[r]);
+ out.close();
+ if(rs.codes) delete [] rs.codes;
+ if(rs.values) delete [] rs.values;
+ if(!out){
+  cerr << "Error while writing " << convert_file_name() << "!... Exiting..." << endl;
+  return false;
+ }
+ if(be_verbose()){
+  cout << "Converted " << rs.n << " observations of " << data_file_name();
+  cout << " into " << convert_file_name() << endl;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the FNV-1a hash of the 'n' bytes at 'p'          //
+//------------------------------------------------------------------------//
+
+static uint64_t hash_bytes(const char *p, size_t n, uint64_t h=14695981039346656037ull)
+{
+ size_t i;
+
+ for(i=0;i<n;i++){
+  h^=(unsigned char) p[i];
+  h*=1099511628211ull;
+ }
+ return h;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the key of a snapshot of the data file mapped    //
+// at 's' ('size' bytes, or none if 's' is NULL): a hash of the options   //
+// which change the sums of cells and of the first line of the file.      //
+//------------------------------------------------------------------------//
+
+unsigned long long data::snapshot_key(const char *s, size_t size)
+{
+ const char *nl;
+ char       t[3];
+ uint64_t   h;
+
+ t[0]=(char) pretransform();
+ t[1]=(char) transformation();
+ t[2]=(char) summary_data();
+ h=hash_bytes(t,3);
+ h=hash_bytes(factor_list(),strlen(factor_list())+1,h);
+ h=hash_bytes(response_name(),strlen(response_name())+1,h);
+ h=hash_bytes(where_clause(),strlen(where_clause())+1,h);
+ if(s){
+  nl=(const char *) memchr(s,'\n',size);
+  h=hash_bytes(s,nl?(size_t) (nl-s):size,h);
+ }
+ return h;
+}
+
+//------------------------------------------------------------------------//
+// This function takes the levels and the sums of cells from the snapshot //
+// mapped between 's' and 'e'. Factors are also set from the snapshot if  //
+// 'header' is true; otherwise they were set by the header of the data    //
+// file and must be the same.                                             //
+//------------------------------------------------------------------------//
+
+bool data::load_snapshot(const char *s, const char *e, bool header)
+{
+ const char *p,*q;
+ LEVCODES   cline;
+ partial    *t;
+ uint64_t   ncells,c;
+ uint32_t   nlev,l;
+ int        nfact,f,len,type,rec;
+ char       name[MAXNAME+1];
+
+ if(e-s<48) goto bad;
+ nfact=get_le(s+40,4);
+ ncells=get_le(s+44,4);
+ if((nfact>MAXFACTORS)||(!header&&(nfact!=get_factors()))) goto bad;
+ p=s+48;
+
+ // Factors and their levels, in the order of their codes
+
+ for(f=0;f<nfact;f++){
+  if(e-p<4) goto bad;
+  type=(unsigned char) p[0];
+  len=get_le(p+2,2);
+  p+=4;
+  if(e-p<len+4) goto bad;
+  memcpy(name,p,len>MAXNAME?MAXNAME:len);
+  name[len>MAXNAME?MAXNAME:len]=0;
+  if(header){
+   if(!set_factor(name)) goto bad;
+   set_factor_type(f,type==RANDOM?RANDOM:FIXED);
+  }
+  else if(strcmp(name,get_factor_name(f))!=0) goto bad;
+  p+=len;
+  nlev=get_le(p,4);
+  p+=4;
+  for(l=0;l<nlev;l++){
+   if(e-p<2) goto bad;
+   len=get_le(p,2);
+   if(e-p<len+2) goto bad;
+   if(set_code(f,string_view(p+2,len))!=(int) l) goto bad;
+   p+=len+2;
+  }
+ }
+ if(e-p<2) goto bad;
+ len=get_le(p,2);
+ if(e-p<len+2) goto bad;
+ memcpy(name,p+2,len>MAXNAME?MAXNAME:len);
+ name[len>MAXNAME?MAXNAME:len]=0;
+ if(header) set_data_name(name);
+ p+=len+2;
+
+ // Cells
+
+ if((p-s)%8) p+=8-(p-s)%8;
+ rec=(4*nfact+7)/8*8;
+ if((uint64_t) (e-p)<ncells*(rec+24)) goto bad;
+ memset(cline,0,sizeof(cline));
+ for(c=0;c<ncells;c++){
+  for(f=0;f<nfact;f++){
+   cline[f]=get_le(p+4*f,4);
+   if(cline[f]>=get_levels(f)) goto bad;
+  }
+  q=p+rec;
+  t=get_partial(cline);
+  t->sum=get_double(q);
+  t->sum2=get_double(q+8);
+  t->n=get_le(q+16,8);
+  nt+=t->n;
+  p+=rec+24;
+ }
+ return true;
+
+ bad:
+ cerr << "Invalid snapshot file " << snapshot_file_name() << "!... Exiting..." << endl;
+ return false;
+}
+
+//------------------------------------------------------------------------//
+// This function writes the snapshot of the data read from the data file  //
+// mapped at 's' ('size' bytes, or none if 's' is NULL) with key 'key'.   //
+// It is written to a temporary file first, which then replaces the old   //
+// snapshot, so a snapshot is never left half written.                    //
+//------------------------------------------------------------------------//
+
+bool data::write_snapshot(unsigned long long key, const char *s, size_t size)
+{
+ ofstream out;
+ string   tmp;
+ partial  *t;
+ uint64_t written;
+ size_t   n;
+ int      f,l;
+
+ if(spill&&!gather_spill()) return false;	// All cells, not just those in memory
+ tmp=string(snapshot_file_name())+".tmp";
+ out.open(tmp,ios::out|ios::binary|ios::trunc);
+ if(!out){
+  cerr << "Error while opening " << tmp << "!... Exiting..." << endl;
+  return false;
+ }
+
+ // Header
+
+ n=(size<SNAPBYTES)?size:SNAPBYTES;
+ out.write("MWC1",4);
+ put_le(out,1,4);
+ put_le(out,key,8);
+ put_le(out,size,8);
+ put_le(out,s?hash_bytes(s,n):0,8);
+ put_le(out,s?hash_bytes(s+size-n,n):0,8);
+ put_le(out,get_factors(),4);
+ put_le(out,npartials,4);
+ written=48;
+ for(f=0;f<get_factors();f++){
+  put_le(out,get_factor_type(f),1);
+  put_le(out,0,1);
+  put_name(out,get_factor_name(f));
+  put_le(out,get_levels(f),4);
+  written+=8+strlen(get_factor_name(f));
+  for(l=0;l<get_levels(f);l++){
+   put_name(out,get_code_name(f,l));
+   written+=2+strlen(get_code_name(f,l));
+  }
+ }
+ put_name(out,data_name);
+ written+=2+strlen(data_name);
+ put_padding(out,written);
+
+ // Cells
+
+ for(t=first;t;t=t->next){
+  for(f=0;f<get_factors();f++) put_le(out,t->orig[f],4);
+  put_padding(out,4*get_factors());
+  put_double(out,t->sum);
+  put_double(out,t->sum2);
+  put_le(out,t->n,8);
+ }
+ out.close();
+ if(!out||(rename(tmp.c_str(),snapshot_file_name())!=0)){
+  cerr << "Error while writing " << snapshot_file_name() << "!... Exiting..." << endl;
+  remove(tmp.c_str());
+  return false;
+ }
+ if(be_verbose()){
+  cout << "Wrote " << npartials << " cells to snapshot " << snapshot_file_name() << endl;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function reads data through the snapshot given with '--snapshot'. //
+// If the snapshot summarizes the whole data file, data are taken from it //
+// and the data file is not parsed. With '--append', if the data file has //
+// grown since, only the new lines are parsed and added to the sums of    //
+// the snapshot. Otherwise the data file is read and the snapshot written //
+// anew. Without a data file name an existing snapshot is used as it is.  //
+//------------------------------------------------------------------------//
+
+bool data::read_snapshot()
+{
+ void       *m,*ms;
+ const char *snap,*s,*e,*nl;
+ size_t     ssize,size,consumed,n;
+ unsigned long long key;
+ struct stat st;
+ int        fd,nt0;
+ bool       ok,valid;
+
+ if(data_files()>1){
+  cerr << "Snapshots can only be taken of a single data file!... Exiting..." << endl;
+  return false;
+ }
+ if(cands){
+  cerr << "Transformations cannot be compared with a snapshot!... Exiting..." << endl;
+  return false;
+ }
+
+ // Map the snapshot, if there is one
+
+ ms=MAP_FAILED;
+ ssize=0;
+ fd=open(snapshot_file_name(),O_RDONLY);
+ if(fd>=0){
+  if((fstat(fd,&st)==0)&&(st.st_size>=48)){
+   ssize=st.st_size;
+   ms=mmap(NULL,ssize,PROT_READ,MAP_PRIVATE,fd,0);
+  }
+  close(fd);
+  if((ms==MAP_FAILED)||(memcmp(ms,"MWC1",4)!=0)||(get_le((const char *) ms+4,4)!=1)){
+   cerr << "Invalid snapshot file " << snapshot_file_name() << "!... Exiting..." << endl;
+   if(ms!=MAP_FAILED) munmap(ms,ssize);
+   return false;
+  }
+ }
+ snap=(ms==MAP_FAILED)?NULL:(const char *) ms;
+
+ // Data from the standard input cannot be checked against the snapshot
+
+ if(strlen(data_file_name())==0){
+  if(snap){
+   if(append_rows()){
+    cerr << "Rows can only be appended from a data file!... Exiting..." << endl;
+    ok=false;
+   }
+   else ok=load_snapshot(snap,snap+ssize,true);
+   munmap(ms,ssize);
+   return ok;
+  }
+  ok=read_stream(0);
+  if(ringbuf) stop_pipeline();
+  return ok&&write_snapshot(snapshot_key(NULL,0),NULL,0);
+ }
+
+ // Map the data file and check if the snapshot summarizes all of it, or
+ // its first 'consumed' bytes
+
+ fd=open(data_file_name(),O_RDONLY);
+ if(fd<0){
+  cerr << "Error while opening " << data_file_name() << "!... Exiting..." << endl;
+  if(snap) munmap(ms,ssize);
+  return false;
+ }
+ m=MAP_FAILED;
+ size=0;
+ if((fstat(fd,&st)==0)&&S_ISREG(st.st_mode)&&(st.st_size>0)){
+  size=st.st_size;
+  m=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+ }
+ if(m==MAP_FAILED){
+  cerr << "Snapshots can only be taken of regular data files!... Exiting..." << endl;
+  close(fd);
+  if(snap) munmap(ms,ssize);
+  return false;
+ }
+ s=(const char *) m;
+ e=s+size;
+ key=snapshot_key(s,size);
+ valid=false;
+ consumed=0;
+ if(snap){
+  consumed=get_le(snap+16,8);
+  n=(consumed<SNAPBYTES)?consumed:SNAPBYTES;
+  valid=(get_le(snap+8,8)==key)&&(consumed>0)&&(consumed<=size)&&
+        (get_le(snap+24,8)==hash_bytes(s,n))&&
+        (get_le(snap+32,8)==hash_bytes(s+consumed-n,n));
+ }
+ if(valid&&(consumed==size)){
+  ok=load_snapshot(snap,snap+ssize,true);
+  if(ok&&be_verbose()){
+   cout << "Read " << npartials << " cells of " << data_file_name();
+   cout << " from snapshot " << snapshot_file_name() << endl;
+  }
+ }
+ else if(valid&&append_rows()&&(s[consumed-1]=='\n')&&
+         (memcmp(s,"MWB1",4)!=0)&&(memcmp(s,"ARROW1",6)!=0)&&((unsigned char) s[0]!=0x1f)){
+
+  // Read the header of the data file, then the snapshot, then new lines
+
+  ok=true;
+  while(ok&&in_header&&(s<e)){
+   nl=(const char *) memchr(s,'\n',e-s);
+   if(!nl) nl=e;
+   ok=parse_line(s,nl);
+   lines++;
+   s=nl+1;
+  }
+  ok=ok&&load_snapshot(snap,snap+ssize,false);
+  nt0=nt;
+  ok=ok&&(parse_buffer((const char *) m+consumed,e,true)!=NULL);
+  if(ringbuf) stop_pipeline();
+  if(ok&&be_verbose()){
+   cout << "Appended " << nt-nt0 << " observations of " << data_file_name();
+   cout << " to snapshot " << snapshot_file_name() << endl;
+  }
+  ok=ok&&write_snapshot(key,(const char *) m,size);
+ }
+ else{
+  if(snap&&be_verbose()){
+   cout << "Snapshot " << snapshot_file_name() << " is out of date" << endl;
+  }
+  ok=read_mapped(fd,size);
+  if(ringbuf) stop_pipeline();
+  ok=ok&&write_snapshot(key,s,size);
+ }
+ munmap(m,size);
+ close(fd);
+ if(snap) munmap(ms,ssize);
+ return ok;
+}
+
+#endif
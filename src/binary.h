@@ -0,0 +1,93 @@
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+// 
+// Little-endian integers and doubles of the binary files mwanova reads
+// from memory or writes: binary data files, snapshots and shards, whose
+// layouts are described in binary.cpp and shard.cpp, and Arrow files.
+
+#ifndef BINARY_H
+#define BINARY_H 1
+
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+//------------------------------------------------------------------------//
+// Little-endian integers and doubles from a mapped file                  //
+//------------------------------------------------------------------------//
+
+inline uint64_t get_le(const char *p, int bytes)
+{
+ uint64_t v=0;
+ int      i;
+
+ for(i=bytes-1;i>=0;i--) v=(v<<8)|(unsigned char) p[i];
+ return v;
+}
+
+inline double get_double(const char *p)
+{
+ uint64_t u;
+ double   v;
+
+ u=get_le(p,8);
+ memcpy(&v,&u,8);
+ return v;
+}
+
+//------------------------------------------------------------------------//
+// Little-endian integers and doubles, names (with their length) and the  //
+// padding to a multiple of 8 bytes of what was 'written', to a file      //
+//------------------------------------------------------------------------//
+
+inline void put_le(std::ofstream &out, uint64_t v, int bytes)
+{
+ char b[8];
+ int  i;
+
+ for(i=0;i<bytes;i++){
+  b[i]=(char) (v&0xff);
+  v>>=8;
+ }
+ out.write(b,bytes);
+}
+
+inline void put_double(std::ofstream &out, double v)
+{
+ uint64_t u;
+
+ memcpy(&u,&v,8);
+ put_le(out,u,8);
+}
+
+inline void put_name(std::ofstream &out, const char *name)
+{
+ put_le(out,strlen(name),2);
+ out.write(name,strlen(name));
+}
+
+inline void put_padding(std::ofstream &out, uint64_t written)
+{
+ char zero[8];
+
+ memset(zero,0,sizeof(zero));
+ if(written%8) out.write(zero,8-written%8);
+}
+
+#endif /* !BINARY_H */
@@ -0,0 +1,751 @@
+// concurrent.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file holds the tables shared by the threads which parse a data file
+// with '--threads', or several data files. Instead of building their own levels and partials, and
+// merging them at the end, all threads insert into one hash table of
+// levels per factor and one hash table of cells. Tables use open
+// addressing with slots claimed by compare-and-swap, so lookups and
+// inserts take no locks. Sums of cells are updated under one of STRIPES
+// spin locks, chosen by the hash of the cell.
+//
+// Chunks are parsed in whatever order threads get to them, so adding the
+// values to the sums of cells as they are parsed would round them
+// differently from run to run. When a data file is parsed by several
+// threads, the observations of each chunk are kept, in the order of their
+// lines, until all chunks before it have been added; then they are added
+// to the sums of their cells one by one, as a serial read would add them,
+// so results are the same whatever the number of threads. No more than
+// FOLDAHEAD chunks are parsed ahead of the first one not yet added.
+//
+// When several data files are read at once, each one by its own thread,
+// each cell keeps the sums of each chunk of lines apart, and these are
+// added at the end in the order of the chunks in the files. Results do not
+// depend on how the threads were scheduled, but may differ in their last
+// digit from those of the files concatenated.
+//
+// Lock-free tables cannot easily grow while they are in use, so the data
+// file is parsed in chunks of about PARCHUNK bytes. Before parsing a chunk
+// a thread reserves room for as many new levels and cells as the chunk has
+// lines; if there is not enough room, it waits until no chunk is being
+// parsed and grows the tables.
+//
+// Levels get codes in the order they are found by any thread, but each
+// level remembers the first line where it was found, so codes are
+// renumbered in file order at the end, as if the file was read serially.
+//
+// The same tables are used to read several data files at once, each one
+// by its own thread.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <shared_mutex>
+#include <thread>
+#include "data.h"
+
+using namespace std;
+
+// A level of a factor found by one of the threads
+
+struct level{
+ char        *name;
+ int         len;
+ int         code;		// Code in the order levels were found
+ atomic<unsigned long long> first; // First line where the level was found
+};
+
+// Sums of the observations of a cell in one chunk of lines
+
+struct piece{
+ unsigned long long key;	// First line of the chunk
+ double   sum;
+ double   sum2;
+ int      n;
+ piece    *next;
+};
+
+// A combination of level codes and the sums of its observations
+
+struct cell{
+ LEVCODES codes;
+ piece    *pieces;		// Sums of each chunk, the last in the file first
+};
+
+// An observation (or the sums of a line of a summary file) waiting to be
+// added to the sums of its cell
+
+struct pending{
+ struct cell *c;
+ double      sum;
+ double      sum2;
+ int         n;
+};
+
+// Hash table of levels or cells. Slots hold NULL or a pointer to an item.
+
+struct ctable{
+ atomic<void *> *slots;
+ int            nslots;
+ atomic<int>    nitems;
+};
+
+struct sharedcells{
+ ctable       levs[MAXFACTORS];	// Levels of each factor
+ ctable       cells;		// Cells
+ atomic<int>  codes[MAXFACTORS];	// Codes given to levels so far
+ int          factors;		// Factors of the lines in the tables
+ atomic<int>  reserved;		// Items chunks being parsed may add
+ atomic<int>  next;		// Next chunk to parse
+ atomic<bool> failed;		// Some thread found an error
+ shared_mutex growing;		// Held exclusively to grow the tables
+ mutex        headers;		// Held to check headers of data files
+ class data   *reference;	// Reader of the first header checked
+ atomic_flag  stripe[STRIPES];	// Locks of the sums of cells
+ vector<pending> *chunkrows;	// Observations of each chunk, with '--threads'
+ bool         *parsed;		// Chunks whose observations are all kept
+ int          added;		// Chunks whose observations have been added
+ mutex        adding;		// Held to add observations of chunks
+ condition_variable moved;	// Signalled when 'added' changes
+};
+
+//------------------------------------------------------------------------//
+// Hash values (FNV-1a) of level names and of lines of 'nf' level codes   //
+//------------------------------------------------------------------------//
+
+static inline unsigned int hash_level(const char *name, size_t len)
+{
+ unsigned int h=2166136261u;
+ size_t i;
+
+ for(i=0;i<len;i++){
+  h^=(unsigned char) name[i];
+  h*=16777619u;
+ }
+ return h;
+}
+
+static inline unsigned int hash_cell(const LEVCODES cline, int nf)
+{
+ unsigned int h=2166136261u;
+ int i;
+
+ for(i=0;i<nf;i++){
+  h^=(unsigned int) cline[i];
+  h*=16777619u;
+ }
+ return h;
+}
+
+//------------------------------------------------------------------------//
+// This function sets up table 't' with 'n' empty slots (a power of 2)    //
+//------------------------------------------------------------------------//
+
+static void init_table(ctable *t, int n)
+{
+ int i;
+
+ t->slots = new atomic<void *>[n];
+ for(i=0;i<n;i++) t->slots[i].store(NULL,memory_order_relaxed);
+ t->nslots=n;
+ t->nitems.store(0,memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------//
+// This function enlarges table 't' of levels (if 'nf' is 0) or of cells  //
+// of 'nf' factors so that it is at most 3/4 full with 'more' items more. //
+// It must only be called when no thread is using the table.              //
+//------------------------------------------------------------------------//
+
+static void grow_table(ctable *t, int more, int nf)
+{
+ atomic<void *> *old;
+ void *p;
+ int  nold,n,i,j;
+
+ n=t->nslots;
+ while(4*((long) t->nitems+more)>3*(long) n) n*=2;
+ if(n==t->nslots) return;
+ old=t->slots;
+ nold=t->nslots;
+ t->slots = new atomic<void *>[n];
+ for(i=0;i<n;i++) t->slots[i].store(NULL,memory_order_relaxed);
+ t->nslots=n;
+ for(i=0;i<nold;i++){
+  p=old[i].load(memory_order_relaxed);
+  if(!p) continue;
+  if(nf==0) j=hash_level(((level *) p)->name,((level *) p)->len);
+  else j=hash_cell(((cell *) p)->codes,nf);
+  j&=n-1;
+  while(t->slots[j].load(memory_order_relaxed)) j=(j+1)&(n-1);
+  t->slots[j].store(p,memory_order_relaxed);
+ }
+ delete [] old;
+}
+
+//------------------------------------------------------------------------//
+// This function tells if table 't' has room for 'more' items             //
+//------------------------------------------------------------------------//
+
+static inline bool has_room(ctable *t, int more)
+{
+ return 4*((long) t->nitems.load(memory_order_relaxed)+more)<=3*(long) t->nslots;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the code of level 'cname' of factor 'factnum' in //
+// the shared tables, adding the level if no thread has found it yet. The //
+// first line where the level was found is kept up to date.               //
+//------------------------------------------------------------------------//
+
+int data::shared_code(int factnum, string_view cname)
+{
+ ctable      *t;
+ level       *l,*n;
+ void        *v;
+ unsigned long long p;
+ int         i;
+
+ t=&shared->levs[factnum];
+ n=NULL;
+ i=hash_level(cname.data(),cname.size())&(t->nslots-1);
+ for(;;){
+  v=t->slots[i].load(memory_order_acquire);
+  if(!v){
+
+   // Try to claim the empty slot with a new level
+
+   if(!n){
+    n = new level;
+    n->name = new char[cname.size()+1];
+    memcpy(n->name,cname.data(),cname.size());
+    n->name[cname.size()]=0;
+    n->len=cname.size();
+    n->code=shared->codes[factnum].fetch_add(1);
+    n->first.store(linekey,memory_order_relaxed);
+   }
+   if(t->slots[i].compare_exchange_strong(v,n,memory_order_acq_rel)){
+    t->nitems.fetch_add(1,memory_order_relaxed);
+    return n->code;
+   }
+  }
+  l=(level *) v;
+  if(((size_t) l->len==cname.size())&&(memcmp(l->name,cname.data(),cname.size())==0)){
+   if(n){
+    delete [] n->name;
+    delete n;
+   }
+   p=l->first.load(memory_order_relaxed);
+   while((linekey<p)&&!l->first.compare_exchange_weak(p,linekey,memory_order_relaxed));
+   return l->code;
+  }
+  i=(i+1)&(t->nslots-1);
+ }
+}
+
+//------------------------------------------------------------------------//
+// This function adds 'count' observations with sum 'sum' and sum of      //
+// squares 'sum2' to the cell with level codes 'cline' in the shared      //
+// tables, adding the cell if no thread has found it yet. With several    //
+// threads parsing one data file they are kept with the observations of   //
+// the chunk being parsed; otherwise they are added to the sums of the    //
+// chunk, which are kept apart from those of other chunks.                //
+//------------------------------------------------------------------------//
+
+void data::shared_add(LEVCODES cline, double sum, double sum2, int count)
+{
+ ctable       *t;
+ cell         *c,*n;
+ piece        **q,*p;
+ void         *v;
+ atomic_flag  *lock;
+ unsigned int h;
+ int          i;
+
+ t=&shared->cells;
+ n=NULL;
+ h=hash_cell(cline,factors);
+ i=h&(t->nslots-1);
+ for(;;){
+  v=t->slots[i].load(memory_order_acquire);
+  if(!v){
+   if(!n){
+    n = new cell;
+    memcpy(n->codes,cline,sizeof(LEVCODES));
+    n->pieces=NULL;
+   }
+   if(t->slots[i].compare_exchange_strong(v,n,memory_order_acq_rel)){
+    t->nitems.fetch_add(1,memory_order_relaxed);
+    c=n;
+    n=NULL;
+    break;
+   }
+  }
+  c=(cell *) v;
+  if(memcmp(c->codes,cline,factors*sizeof(int))==0) break;
+  i=(i+1)&(t->nslots-1);
+ }
+ if(n) delete n;
+ if(shared->chunkrows){
+  shared->chunkrows[chunkkey>>18].push_back({c,sum,sum2,count});
+  return;
+ }
+
+ lock=&shared->stripe[h&(STRIPES-1)];
+ while(lock->test_and_set(memory_order_acquire)) this_thread::yield();
+
+ // Chunks being parsed are usually the last ones, near the head
+
+ for(q=&c->pieces;*q&&((*q)->key>chunkkey);q=&(*q)->next);
+ p=*q;
+ if(!p||(p->key!=chunkkey)){
+  p = new piece;
+  p->key=chunkkey;
+  p->sum=0;
+  p->sum2=0;
+  p->n=0;
+  p->next=*q;
+  *q=p;
+ }
+ p->sum+=sum;
+ p->sum2+=sum2;
+ p->n+=count;
+ lock->clear(memory_order_release);
+}
+
+//------------------------------------------------------------------------//
+// This function makes sure the shared tables have room for the levels    //
+// and cells of 'rows' lines, growing them if needed. It returns with a   //
+// shared hold of 'growing', so the tables are not grown while the lines  //
+// are parsed, until release_shared() is called.                          //
+//------------------------------------------------------------------------//
+
+void data::reserve_shared(int rows)
+{
+ int  r,f,nf;
+ bool room;
+
+ nf=shared->factors;
+ for(;;){
+  shared->growing.lock_shared();
+  r=shared->reserved.fetch_add(rows)+rows;
+  room=has_room(&shared->cells,r);
+  for(f=0;room&&(f<nf);f++) room=has_room(&shared->levs[f],r);
+  if(room) return;
+  shared->reserved.fetch_sub(rows);
+  shared->growing.unlock_shared();
+
+  // Wait until no chunk is being parsed, then grow
+
+  shared->growing.lock();
+  grow_table(&shared->cells,rows,nf);
+  for(f=0;f<nf;f++) grow_table(&shared->levs[f],rows,0);
+  shared->growing.unlock();
+ }
+}
+
+//------------------------------------------------------------------------//
+// This function releases the room reserved for 'rows' lines, and the     //
+// hold of 'growing', once the lines are parsed.                          //
+//------------------------------------------------------------------------//
+
+void data::release_shared(int rows)
+{
+ shared->reserved.fetch_sub(rows);
+ shared->growing.unlock_shared();
+}
+
+//------------------------------------------------------------------------//
+// This function adds the observations of chunk 'k' of 'nchunks', once    //
+// they have all been kept, and those of the chunks after it which are    //
+// ready, if all chunks before it have been added. Observations are added //
+// to the sums of their cells in the order of the lines of the file.      //
+//------------------------------------------------------------------------//
+
+static void add_chunk(sharedcells *sc, int k, int nchunks)
+{
+ vector<pending> *v;
+ piece           *p;
+ size_t          i;
+
+ lock_guard<mutex> g(sc->adding);
+ sc->parsed[k]=true;
+ while((sc->added<nchunks)&&sc->parsed[sc->added]){
+  v=&sc->chunkrows[sc->added];
+  for(i=0;i<v->size();i++){
+   p=(*v)[i].c->pieces;
+   if(!p){
+    p = new piece;
+    p->key=0;
+    p->sum=0;
+    p->sum2=0;
+    p->n=0;
+    p->next=NULL;
+    (*v)[i].c->pieces=p;
+   }
+   p->sum+=(*v)[i].sum;
+   p->sum2+=(*v)[i].sum2;
+   p->n+=(*v)[i].n;
+  }
+  vector<pending>().swap(*v);
+  sc->added++;
+ }
+ sc->moved.notify_all();
+}
+
+//------------------------------------------------------------------------//
+// This function parses chunks of lines (between 'chunk[k]' and           //
+// 'chunk[k+1]') into the shared tables until there are no more chunks    //
+// left among 'nchunks'. It runs in one of the parsing threads, which     //
+// waits before parsing a chunk too far ahead of the first one whose      //
+// observations have not been added yet.                                  //
+//------------------------------------------------------------------------//
+
+bool data::parse_chunks(const char **chunk, int nchunks)
+{
+ const char *b,*c;
+ int        k;
+ bool       ok;
+
+ while((k=shared->next.fetch_add(1))<nchunks){
+  {
+   unique_lock<mutex> g(shared->adding);
+   shared->moved.wait(g,[&]{ return (k<shared->added+FOLDAHEAD)||shared->failed.load(); });
+  }
+  if(shared->failed.load(memory_order_relaxed)) return false;
+  b=chunk[k];
+  c=chunk[k+1];
+  keybase=((unsigned long long) k)<<18;	// Chunks have less
+  lines=0;				// than 2^18 lines
+  ok=(parse_buffer(b,c,true)!=NULL);
+  if(!ok){
+   lock_guard<mutex> g(shared->adding);
+   shared->failed.store(true,memory_order_relaxed);
+   shared->moved.notify_all();
+   return false;
+  }
+  add_chunk(shared,k,nchunks);
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// Levels sorted by the first line where they were found                  //
+//------------------------------------------------------------------------//
+
+static int first_found(const void *a, const void *b)
+{
+ unsigned long long p=(*(level **) a)->first.load(memory_order_relaxed);
+ unsigned long long q=(*(level **) b)->first.load(memory_order_relaxed);
+
+ return (p<q)?-1:((p>q)?1:0);
+}
+
+//------------------------------------------------------------------------//
+// This function moves the levels and cells of the shared tables 'sc'     //
+// into the dictionaries and the list of partials, once all threads are   //
+// done. Levels are given codes in the order they appear in the file, and //
+// the sums of the chunks of each cell are added in the same order.       //
+//------------------------------------------------------------------------//
+
+void data::collect_shared(sharedcells *sc)
+{
+ level    **l;
+ cell     *c;
+ piece    *p,*q,*r;
+ partial  *t;
+ int      *map[MAXFACTORS];
+ int      f,i,j;
+ LEVCODES cline;
+
+ for(f=0;f<factors;f++){
+  l = new level*[sc->levs[f].nitems.load()+1];
+  map[f] = new int[sc->codes[f].load()+1];
+  for(i=j=0;i<sc->levs[f].nslots;i++){
+   if(sc->levs[f].slots[i].load()) l[j++]=(level *) sc->levs[f].slots[i].load();
+  }
+  qsort(l,j,sizeof(level *),first_found);
+  for(i=0;i<j;i++) map[f][l[i]->code]=set_code(f,l[i]->name);
+  delete [] l;
+ }
+ memset(cline,0,sizeof(cline));
+ for(i=0;i<sc->cells.nslots;i++){
+  c=(cell *) sc->cells.slots[i].load();
+  if(!c) continue;
+  for(f=0;f<factors;f++) cline[f]=map[f][c->codes[f]];
+  t=get_partial(cline);
+  for(p=c->pieces,r=NULL;p;p=q){	// Reverse, to the order in the file
+   q=p->next;
+   p->next=r;
+   r=p;
+  }
+  for(p=c->pieces=r;p;p=p->next){
+   t->sum+=p->sum;
+   t->sum2+=p->sum2;
+   t->n+=p->n;
+  }
+ }
+ for(f=0;f<factors;f++) delete [] map[f];
+}
+
+//------------------------------------------------------------------------//
+// These functions create and remove the shared tables                    //
+//------------------------------------------------------------------------//
+
+static sharedcells *new_shared()
+{
+ sharedcells *s;
+ int         i;
+
+ s = new sharedcells;
+ for(i=0;i<MAXFACTORS;i++){
+  init_table(&s->levs[i],1024);
+  s->codes[i].store(0);
+ }
+ init_table(&s->cells,1024);
+ s->reserved.store(0);
+ s->next.store(0);
+ s->failed.store(false);
+ s->factors=0;
+ s->reference=NULL;
+ s->chunkrows=NULL;
+ s->parsed=NULL;
+ s->added=0;
+ for(i=0;i<STRIPES;i++) s->stripe[i].clear();
+ return s;
+}
+
+static void delete_shared(sharedcells *s)
+{
+ level *l;
+ cell  *c;
+ piece *p;
+ int   i,j;
+
+ for(i=0;i<MAXFACTORS;i++){
+  for(j=0;j<s->levs[i].nslots;j++){
+   l=(level *) s->levs[i].slots[j].load();
+   if(l){
+    delete [] l->name;
+    delete l;
+   }
+  }
+  delete [] s->levs[i].slots;
+ }
+ for(j=0;j<s->cells.nslots;j++){
+  c=(cell *) s->cells.slots[j].load();
+  if(!c) continue;
+  while((p=c->pieces)!=NULL){
+   c->pieces=p->next;
+   delete p;
+  }
+  delete c;
+ }
+ delete [] s->cells.slots;
+ if(s->chunkrows) delete [] s->chunkrows;
+ if(s->parsed) delete [] s->parsed;
+ delete s;
+}
+
+//------------------------------------------------------------------------//
+// This function parses the body of a data file (between 's' and 'e', the //
+// header has been read already) with 'nthreads' threads. The body is     //
+// split in chunks of lines of about PARCHUNK bytes, which are parsed by  //
+// workers ('data' objects with the same factors) as they become free.    //
+// All workers add levels and cells to the same shared tables, which are  //
+// moved to this object at the end. If a worker finds an error the body   //
+// is parsed again serially to report it with the right line number.      //
+//------------------------------------------------------------------------//
+
+bool data::read_parallel(const char *s, const char *e, int nthreads)
+{
+ sharedcells *sc;
+ data        **w;
+ thread      *th;
+ bool        *ok,good;
+ const char  **chunk,*c,*nl;
+ int         i,nchunks;
+
+ // Chunks start at the beginning of lines
+
+ nchunks=(e-s)/PARCHUNK+1;
+ chunk = new const char*[nchunks+1];
+ chunk[0]=s;
+ for(i=1;i<nchunks;i++){
+  c=s+(long) i*PARCHUNK;
+  if(c<chunk[i-1]) c=chunk[i-1];
+  nl=(const char *) memchr(c,'\n',e-c);
+  chunk[i]=nl?(nl+1):e;
+ }
+ chunk[nchunks]=e;
+
+ sc=new_shared();
+ sc->factors=factors;
+ sc->chunkrows = new vector<pending>[nchunks];
+ sc->parsed = new bool[nchunks];
+ for(i=0;i<nchunks;i++) sc->parsed[i]=false;
+ w = new data*[nthreads];
+ th = new thread[nthreads];
+ ok = new bool[nthreads];
+ for(i=0;i<nthreads;i++){
+  w[i] = new data;
+  *(base *) w[i]=*(base *) this;
+  w[i]->factors=factors;
+  memcpy(w[i]->factor_name,factor_name,sizeof(factor_name));
+  memcpy(w[i]->factor_type,factor_type,sizeof(factor_type));
+  w[i]->in_header=false;
+  w[i]->datacol=datacol;
+  w[i]->ncols=ncols;
+  memcpy(w[i]->factcol,factcol,sizeof(factcol));
+  w[i]->stats=stats;
+  memcpy(w[i]->statcol,statcol,sizeof(statcol));
+  w[i]->filters=filters;		// Shared, not owned by workers
+  w[i]->nfilters=nfilters;
+  w[i]->shared=sc;
+  w[i]->kernel=kernel;
+  w[i]->quiet=true;
+  th[i]=thread([=]{ ok[i]=w[i]->parse_chunks(chunk,nchunks); });
+ }
+ good=true;
+ for(i=0;i<nthreads;i++){
+  th[i].join();
+  if(!ok[i]) good=false;
+ }
+ if(good){
+  collect_shared(sc);
+  for(i=0;i<nthreads;i++) nt+=w[i]->nt;
+ }
+ for(i=0;i<nthreads;i++){
+  w[i]->filters=NULL;
+  delete w[i];
+ }
+ delete_shared(sc);
+ delete [] ok;
+ delete [] th;
+ delete [] w;
+ delete [] chunk;
+ if(!good) return parse_buffer(s,e,true)!=NULL;
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function checks, once the header of one of several data files has //
+// been read, that its factors (names, types and order) and data name are //
+// the same of the other files. The first file checked is the reference.  //
+//------------------------------------------------------------------------//
+
+bool data::check_header()
+{
+ data *r;
+ int  f;
+ bool same;
+
+ lock_guard<mutex> g(shared->headers);
+ r=shared->reference;
+ if(!r){
+  shared->reference=this;
+  shared->factors=factors;
+  return true;
+ }
+ same=(factors==r->factors)&&(strcmp(data_name,r->data_name)==0);
+ for(f=0;same&&(f<factors);f++){
+  same=(strcmp(factor_name[f],r->factor_name[f])==0)&&(factor_type[f]==r->factor_type[f]);
+ }
+ if(!same){
+  cerr << "Factors of " << data_file_name() << " differ from those of ";
+  cerr << r->data_file_name() << "!... Exiting..." << endl;
+ }
+ return same;
+}
+
+//------------------------------------------------------------------------//
+// This function reads all data files given with '-f' into the shared     //
+// tables. Each file is read by a worker (a 'data' object of its own,     //
+// which reads the header of the file as usual); up to 'workers()' files, //
+// or as many as there are processors if '--threads' is not given, are    //
+// read at once. Lines are ordered by file and then by line number, so    //
+// levels have the codes they would have in the files concatenated.       //
+//------------------------------------------------------------------------//
+
+bool data::read_files()
+{
+ sharedcells *sc;
+ data        **w,*r;
+ thread      *th;
+ bool        *ok,good;
+ int         i,k,nfiles,nthreads;
+
+ nfiles=data_files();
+ nthreads=workers(nfiles);
+
+ sc=new_shared();
+ w = new data*[nfiles];
+ ok = new bool[nfiles];
+ for(k=0;k<nfiles;k++){
+  w[k] = new data;
+  *(base *) w[k]=*(base *) this;
+  w[k]->set_data_file(k);
+  w[k]->lines=0;
+  w[k]->in_header=true;
+  w[k]->keybase=((unsigned long long) k)<<44;
+  w[k]->shared=sc;
+  w[k]->kernel=kernel;
+  ok[k]=false;
+ }
+ th = new thread[nthreads];
+ for(i=0;i<nthreads;i++){
+  th[i]=thread([=]{
+   int f;
+   while(((f=sc->next.fetch_add(1))<nfiles)&&!sc->failed.load()){
+    ok[f]=w[f]->read_file();
+    if(!ok[f]) sc->failed.store(true);
+   }
+  });
+ }
+ for(i=0;i<nthreads;i++) th[i].join();
+ good=!sc->failed.load();
+
+ // Factors are those of the reference file
+ 
+ r=sc->reference;
+ if(good&&r){
+  factors=r->factors;
+  memcpy(factor_name,r->factor_name,sizeof(factor_name));
+  memcpy(factor_type,r->factor_type,sizeof(factor_type));
+  strcpy(data_name,r->data_name);
+  collect_shared(sc);
+  for(k=0;k<nfiles;k++) nt+=w[k]->nt;
+ }
+ for(k=0;k<nfiles;k++) delete w[k];
+ delete_shared(sc);
+ delete [] th;
+ delete [] ok;
+ delete [] w;
+ return good;
+}
+
+#endif
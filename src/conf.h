@@ -27,8 +27,18 @@
 #endif
 
 #define MAXFACTORS 10     	// Maximum number of factors allowed           
-#define MAXLEVELS  100     	// Maximum number of levels per factor allowed 
 #define MAXNAME	   10     	// Maximum name size (of factors or codes) in chars
+#define BLOCKSIZE  1048576	// Size of blocks read from pipes or standard input
+#define MINCHUNK   1048576	// Minimum size of data parsed by each thread
+#define PARCHUNK   262144	// Size of chunks of data parsed by threads
+#define STRIPES    4096		// Locks of the sums of cells shared by threads
+#define FOLDAHEAD  64		// Chunks parsed ahead of those added to the cells
+#define GZBLOCKS   4		// Blocks of inflated data waiting to be parsed
+#define RINGSIZE   16		// Batches of observations in the '--pipeline' ring
+#define RINGBATCH  4096	// Observations per batch
+#define TRANSBATCH 1024	// Observations transformed together
+#define SNAPBYTES  4096	// Bytes hashed at each end of data files in snapshots
+#define RESPBLOCK  256		// Responses whose sums of squares are computed together
 
 
 // COMBINS is equal to 2^MAXFACTORS
@@ -53,9 +63,9 @@
 
 typedef   char 	FACTORNAMES[MAXFACTORS][MAXNAME+1];
 typedef   char  DATANAME[MAXNAME+1];
-typedef   char	LEVELS[MAXFACTORS];
+typedef   int	LEVELS[MAXFACTORS];
 typedef   char  CODES[MAXFACTORS];
-typedef   char  CODENAMES[MAXFACTORS][MAXLEVELS][MAXNAME+1];
+typedef   int   LEVCODES[MAXFACTORS];
 typedef   char	FACTORTYPES[MAXFACTORS];
 typedef   char	NESTED[MAXFACTORS][MAXFACTORS];
 
@@ -70,6 +80,12 @@ typedef   char	NESTED[MAXFACTORS][MAXFACTORS];
 #define MULT100         6
 #define DIV100		7  
 
+// Some defs for the kinds of data files
+
+#define RAWDATA		0	// One observation per line
+#define SUMDATA		1	// Replicates, sum and sum of squares per cell
+#define MEANDATA	2	// Replicates, mean and variance per cell
+
 // Some defs for the multiple tests
 
 #define NOMTESTS	0
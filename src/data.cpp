@@ -21,14 +21,28 @@
 // 
 
 #include <iostream>
-#include <fstream>
 #ifdef CGI
 #include <sstream>
 #endif
 #include <cstdlib>
 #include <iomanip>
 #include <cstring>
+#include <cctype>
 #include <cmath>
+#include <cerrno>
+#include <cstdint>
+#include <charconv>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#ifndef CGI
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "data.h"
 #include "probs.h"
 using namespace std;
@@ -38,27 +52,128 @@ using namespace std;
 //************************************************************************//
 
 //------------------------------------------------------------------------//
-// This function sets the code for a new level 'cname' of factor 'factnum'// 
-// First it tests if factor 'factnum' has level 'cname'. If so it returns //
-// the char code corresponding to the level. If there is no level with    //
-// name 'cname' it adds another level to factor 'ffactnum' and increases  //
-// 'levels[]' accordingly, returning the new char code                    //
+// This function returns a hash value for the level name 'name' (FNV-1a)  //
+//------------------------------------------------------------------------//
+
+static inline unsigned int hash_name(string_view name)
+{
+ unsigned int h=2166136261u;
+ size_t i;
+ 
+ for(i=0;i<name.size();i++){
+  h^=(unsigned char) name[i];
+  h*=16777619u;
+ }
+ return h;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the index of 'name' in dictionary 'd', looking   //
+// it up in its hash index, or -1 if 'name' is not there.                 //
+//------------------------------------------------------------------------//
+
+static inline int find_name(dictionary *d, string_view name)
+{
+ int j,k;
+ 
+ if(d->nslots==0) return -1;
+ j=hash_name(name)&(d->nslots-1);
+ while((k=d->slots[j])!=0){
+  if(name==d->names[k-1]) return k-1;
+  j=(j+1)&(d->nslots-1);
+ }
+ return -1;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the index of 'name' in dictionary 'd', adding    //
+// it to the dictionary if it is not there yet. The dictionary grows as   //
+// needed, so the number of names is only limited by memory.              //
+//------------------------------------------------------------------------//
+
+static int add_name(dictionary *d, string_view name)
+{
+ char **names;
+ int  i,j,k;
+ 
+ // Keep the index at most half full
+ 
+ if(2*(d->nnames+1)>d->nslots){
+  if(d->slots) delete [] d->slots;
+  d->nslots=(d->nslots>0)?2*d->nslots:64;
+  d->slots = new int[d->nslots];
+  memset(d->slots,0,d->nslots*sizeof(int));
+  for(i=0;i<d->nnames;i++){
+   j=hash_name(d->names[i])&(d->nslots-1);
+   while(d->slots[j]) j=(j+1)&(d->nslots-1);
+   d->slots[j]=i+1;
+  }
+ }
+ j=hash_name(name)&(d->nslots-1);
+ while((k=d->slots[j])!=0){
+  if(name==d->names[k-1]) return k-1;
+  j=(j+1)&(d->nslots-1);
+ }
+ 
+ // A new name
+ 
+ if(d->nnames==d->maxnames){
+  d->maxnames=2*d->maxnames+16;
+  names = new char*[d->maxnames];
+  if(d->names){
+   memcpy(names,d->names,d->nnames*sizeof(char *));
+   delete [] d->names;
+  }
+  d->names=names;
+ }
+ i=d->nnames++;
+ d->names[i] = new char[name.size()+1];
+ memcpy(d->names[i],name.data(),name.size());
+ d->names[i][name.size()]=0;
+ d->slots[j]=i+1;
+ return i;
+}
+
+//------------------------------------------------------------------------//
+// This function frees the names and the hash index of dictionary 'd'     //
 //------------------------------------------------------------------------//
 
-char data::set_code(int factnum, const char *cname)
+static void free_names(dictionary *d)
 {
  int i;
- if((factnum>=0)&&(factnum<factors)){
-  for(i=0;i<levels[factnum];i++){
-   if(strcmp(code_name[factnum][i],cname)==0) return (char) i;
-  } 
-  i=levels[factnum];
+ 
+ for(i=0;i<d->nnames;i++) delete [] d->names[i];
+ if(d->names) delete [] d->names;
+ if(d->slots) delete [] d->slots;
+ memset(d,0,sizeof(dictionary));
+}
+
+//------------------------------------------------------------------------//
+// This function sets the code for a new level 'cname' of factor 'factnum'// 
+// First it tests if factor 'factnum' has level 'cname', looking it up in //
+// the dictionary of the factor. If so it returns the code corresponding  //
+// to the level. If there is no level with name 'cname' it adds another   //
+// level to factor 'factnum' and increases 'levels[]' accordingly,        //
+// returning the new code.                                                //
+//------------------------------------------------------------------------//
+
+int data::set_code(int factnum, string_view cname)
+{
+ dictionary *d;
+ int        i,n;
+ 
+ if((factnum<0)||(factnum>=factors)) return 0;
+ #ifndef CGI
+ if(shared) return shared_code(factnum,cname);
+ #endif
+ d=&code_name[factnum];
+ n=d->nnames;
+ i=add_name(d,cname);
+ if(d->nnames>n){
   levels[factnum]++;
   origlevels[factnum]++;
-  strcpy(code_name[factnum][i],cname);
-  return (char) i; 
  }
- else return 0; 
+ return i; 
 }
 
 //------------------------------------------------------------------------//
@@ -73,113 +188,204 @@ void data::set_factor_type(int factnum, char ftype)
 }
 
 //------------------------------------------------------------------------//
-// This function adds an observation to a list of partials. Each partial  //
-// has a code line which bears the codes of the levels of each factor in  //
-// the analysis. 'cline' is compared with the code lines of all items in  // 
-// the list to check if a value should be added to an existent partial or //
-// if a new partial should be created. If an item with a similar 'cline'  //
-// is present, the value 'val' is added to the sum and sum of squares,    //
-// and the 'n' is updated, otherwise a new item is created. Items are     //
-// inserted in a sorted way to facilitate the subsequent computations.    //
+// This function returns a hash value for the level codes in 'cline'. It  //
+// is used to index the list of partials in 'cells' (FNV-1a hash).        //
 //------------------------------------------------------------------------//
 
-void data::add_code_line(CODES cline, double val)
+unsigned int data::hash_codes(LEVCODES cline)
 {
- bool equal,inserted;
- partial *t1, *t2;
+ unsigned int h=2166136261u;
+ int i;
  
- if(!first){	
- 		
-  // First item is null, so create it! 
-    
-  first = new partial;
-  npartials++;
-  memcpy(first->codes,cline,MAXFACTORS);
-  memcpy(first->orig,cline,MAXFACTORS);
-  first->sum=val;
-  first->sum2=pow(val,2);
-  first->n=1;
-  first->next=NULL;
-  last=first;  
- }
- else{				
-  
-  // Items exist, so compare them with 'cline'
-  
-  t1=first; 
-  
-  do{
-   equal=true;
-   if(memcmp(cline,t1->codes,MAXFACTORS)!=0) equal=false;
-   if(!equal) t1=t1->next;
-  }while((t1!=NULL)&&(!equal));
-  
-  if(equal){			
-   
-   // There is an item similar to 'cline'... add the data
-   
-   t1->sum+=val;
-   t1->sum2+=pow(val,2);
-   t1->n++;
-   
+ for(i=0;i<factors;i++){
+  h^=(unsigned int) cline[i];
+  h*=16777619u;
+ }
+ return h;
+}
+
+//------------------------------------------------------------------------//
+// This function compares two lines of level codes, factor by factor. It  //
+// returns a negative, zero or positive value like memcmp().              //
+//------------------------------------------------------------------------//
+
+int data::compare_codes(LEVCODES c1, LEVCODES c2)
+{
+ int i;
+ 
+ for(i=0;i<factors;i++){
+  if(c1[i]!=c2[i]) return (c1[i]<c2[i])?-1:1;
+ }
+ return 0;
+}
+
+//------------------------------------------------------------------------//
+// This function doubles the number of slots of the hash index 'cells'    //
+// and inserts all existing partials again. Slots are found by linear     //
+// probing, starting at the slot given by the hash of the original codes. //
+//------------------------------------------------------------------------//
+
+void data::grow_cells()
+{
+ partial **old,*t;
+ int     nold,i,j;
+ 
+ old=cells;
+ nold=ncells;
+ if(ncells>0) ncells*=2;
+ else ncells=1024;
+ cells = new partial*[ncells];
+ memset(cells,0,ncells*sizeof(partial *));
+ for(i=0;i<nold;i++){
+  t=old[i];
+  if(t){
+   j=hash_codes(t->orig)&(ncells-1);
+   while(cells[j]) j=(j+1)&(ncells-1);
+   cells[j]=t;
   }
-  else{
-  	
-   // 'cline' is a new item, create and insert it!
-  
-   t1=first;
-   if(memcmp(cline,t1->codes,MAXFACTORS)<0){   	
-   
-    // 't1' is inserted before 'first'
-    
-    t1 = new partial;
-    npartials++;
-    t1->next=first;
-    memcpy(t1->codes,cline,MAXFACTORS);
-    memcpy(t1->orig,cline,MAXFACTORS);
-    t1->sum=val;
-    t1->sum2=pow(val,2);
-    t1->n=1;
-    first=t1;
+ }
+ if(old) delete [] old;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the partial with level codes 'cline'. Each       //
+// partial has a code line which bears the codes of the levels of each    //
+// factor in the analysis. 'cline' is looked up in the hash index 'cells' //
+// and, if there is no item with a similar code line, a new partial with  //
+// no observations is created and appended to the list. The list is only  //
+// sorted once, by 'sort_partials()', when all data have been read. The   //
+// index is keyed on 'orig' because 'codes' is modified later on by       //
+// 'orthogonalize()'.                                                     //
+//------------------------------------------------------------------------//
+
+partial *data::get_partial(LEVCODES cline)
+{
+ partial *t;
+ int     i;
+ 
+ // Keep the index at most half full
+ 
+ if(2*(npartials+1)>ncells) grow_cells();
+ 
+ i=hash_codes(cline)&(ncells-1);
+ while((t=cells[i])!=NULL){
+  if(memcmp(cline,t->orig,sizeof(LEVCODES))==0) return t;
+  i=(i+1)&(ncells-1);
+ }
+ 
+ // 'cline' is a new item, create it and append it to the list
+ 
+ #ifndef CGI
+ if(spill&&make_room()) i=hash_codes(cline)&(ncells-1);	// Index was cleared
+ #endif
+ t = new partial;
+ npartials++;
+ memcpy(t->codes,cline,sizeof(LEVCODES));
+ memcpy(t->orig,cline,sizeof(LEVCODES));
+ t->sum=0;
+ t->sum2=0;
+ t->var=0;
+ t->n=0;
+ t->vec=NULL;
+ t->next=NULL;
+ t->prev=last;
+ if(last) last->next=t;
+ else first=t;
+ last=t;
+ cells[i]=t;
+ return t;
+}
+
+//------------------------------------------------------------------------//
+// This function adds an observation to the partial with level codes      //
+// 'cline': the value 'val' is added to the sum and sum of squares, and   //
+// the 'n' is updated.                                                    //
+//------------------------------------------------------------------------//
+
+void data::add_code_line(LEVCODES cline, double val)
+{
+ partial *t;
+ 
+ t=get_partial(cline);
+ t->sum+=val;
+ t->sum2+=pow(val,2);
+ t->n++;
+}
+
+//------------------------------------------------------------------------//
+// This function stores an observation in 'rows', enlarging it as needed  //
+//------------------------------------------------------------------------//
+
+void data::add_row(LEVCODES cline, double val)
+{
+ LEVCODES *c;
+ double *v;
+ 
+ if(rows->n==rows->max){
+  rows->max=2*rows->max+1024;
+  c = new LEVCODES[rows->max];
+  v = new double[rows->max];
+  if(rows->n>0){
+   memcpy(c,rows->codes,rows->n*sizeof(LEVCODES));
+   memcpy(v,rows->values,rows->n*sizeof(double));
+   delete [] rows->codes;
+   delete [] rows->values;
+  }
+  rows->codes=c;
+  rows->values=v;
+ }
+ memcpy(rows->codes[rows->n],cline,sizeof(LEVCODES));
+ rows->values[rows->n]=val;
+ rows->n++;
+}
+
+//------------------------------------------------------------------------//
+// This function sorts the list of partials by their level codes, which   //
+// is the order expected by all subsequent computations. It is a bottom-up//
+// merge sort of the linked list, so it costs O(n log n) and is called    //
+// once after all observations have been added.                           //
+//------------------------------------------------------------------------//
+
+void data::sort_partials()
+{
+ partial *p,*q,*e,*tail,*list;
+ int     insize,nmerges,psize,qsize,i;
+ 
+ if(!first) return;
+ list=first;
+ insize=1;
+ do{
+  p=list;
+  list=NULL;
+  tail=NULL;
+  nmerges=0;
+  while(p){
+   nmerges++;
+   q=p;
+   psize=0;
+   for(i=0;i<insize;i++){
+    psize++;
+    q=q->next;
+    if(!q) break;
    }
-   else{
-    inserted=false;
-    while((t1->next!=NULL)&&(!inserted)){	
-    
-     // 't1' is inserted into the list
-     
-     if(memcmp(cline,t1->next->codes,MAXFACTORS)<0){
-      t2 = new partial;
-      npartials++;
-      memcpy(t2->codes,cline,MAXFACTORS);
-      memcpy(t2->orig,cline,MAXFACTORS);
-      t2->sum=val;
-      t2->sum2=pow(val,2);
-      t2->n=1;
-      t2->next=t1->next;
-      t1->next=t2;
-      inserted=true;
-     }
-     t1=t1->next;
-    }
-    if(!inserted){				
-    
-     // 't1' is inserted at the end of the list
-     
-     t1=last;
-     last = new partial;
-     npartials++;
-     memcpy(last->codes,cline,MAXFACTORS);
-     memcpy(last->orig,cline,MAXFACTORS);
-     last->sum=val;
-     last->sum2=pow(val,2);
-     last->n=1;
-     last->next=NULL;
-     t1->next=last;
-    } 
+   qsize=insize;
+   while((psize>0)||((qsize>0)&&q)){
+    if(psize==0){ e=q; q=q->next; qsize--; }
+    else if((qsize==0)||(!q)){ e=p; p=p->next; psize--; }
+    else if(compare_codes(p->codes,q->codes)<=0){ e=p; p=p->next; psize--; }
+    else{ e=q; q=q->next; qsize--; }
+    if(tail) tail->next=e;
+    else list=e;
+    e->prev=tail;
+    tail=e;
    }
-  } 
- }
+   p=q;
+  }
+  tail->next=NULL;
+  insize*=2;
+ }while(nmerges>1);
+ first=list;
+ last=tail;
 }
 
 
@@ -191,6 +397,36 @@ data::data()
 {
  first=NULL;
  last =NULL;
+ cells=NULL;
+ ncells=0;
+ grid=NULL;
+ quiet=false;
+ tokens=NULL;
+ maxtokens=0;
+ rows=NULL;
+ datacol=-1;
+ ncols=0;
+ memset(factcol,0,sizeof(factcol));
+ stats=RAWDATA;
+ memset(statcol,0,sizeof(statcol));
+ shared=NULL;
+ keybase=0;
+ linekey=0;
+ chunkkey=0;
+ parse_until=0;
+ ringbuf=NULL;
+ filters=NULL;
+ nfilters=0;
+ kernel=NULL;
+ batchcodes=NULL;
+ batchvalues=NULL;
+ nbatch=0;
+ cands=NULL;
+ win=NULL;
+ resp=NULL;
+ split=NULL;
+ spill=NULL;
+ merged=NULL;
  
  factors=0;
  n=0;
@@ -199,6 +435,7 @@ data::data()
  npartials=0;
  
  memset(levels,0,sizeof(levels));
+ memset(origlevels,0,sizeof(origlevels));
  memset(factor_name,0,sizeof(factor_name));
  memset(factor_type,0,sizeof(factor_type));
  memset(code_name,0,sizeof(code_name));
@@ -213,13 +450,41 @@ data::data()
 data::~data()
 {
  partial *t;
+ int     i;
+ 
+ #ifndef CGI
+ if(spill) stop_spill();		// Cells may be in a mapped file
+ if(merged) stop_merge();
+ #endif
  if(first){
   do{
    t=first->next;
+   if(first->vec) delete [] first->vec;
    delete first;
    first=t;
   }while(first); 
  }
+ if(cells) delete [] cells;
+ if(grid) free_grid();
+ if(tokens) delete [] tokens;
+ for(i=0;i<MAXFACTORS;i++) free_names(&code_name[i]);
+ if(filters){
+  for(i=0;i<nfilters;i++){
+   free_names(&filters[i].literals);
+   if(filters[i].accept) delete [] filters[i].accept;
+  }
+  delete [] filters;
+ }
+ if(batchcodes) delete [] batchcodes;
+ if(batchvalues) delete [] batchvalues;
+ #ifndef CGI
+ if(cands) stop_candidates();
+ if(resp) stop_responses();
+ if(split){
+  free_names(&split->names);
+  stop_split();
+ }
+ #endif
  #ifdef DEBUG_DATA
  cout << "Destructing 'data' variable" << endl;
  #endif
@@ -284,27 +549,24 @@ void data::set_data_name(const char *dname)
 //------------------------------------------------------------------------//
 // This function adds a level code (that has been read from the datafile) //
 // to the temporary variable 'code_line', inserting it in the position    //
-// corresponding to the factor number. Code names are converted to a      //
-// single and unique char (thus, no more than 250 levels can be           //
-// represented, but that is fair enough...)                               //
+// corresponding to the factor number. Code names are converted to an    //
+// unique integer code by 'set_code()'.                                   //
 //------------------------------------------------------------------------//
 
-bool data::add_code(int factnum, const char *cname, int l)
+bool data::add_code(int factnum, string_view cname, int l)
 {
- char cn[100];
- 
- strncpy(cn,cname,100);
- if(strlen(cn)>(MAXNAME)) strncpy(cn,cn,MAXNAME); // Trim long code names 
  if((factnum>=0)&&(factnum<factors)){
-  code_line[factnum]=set_code(factnum, cn);
+  code_line[factnum]=set_code(factnum, cname);
  }
  else{
   #ifdef CGI
   cout << "Number of codes exceeds number of factors (";
   cout << get_factors() << ") in line " << l+1 << "<p>" << endl;
   #else
-  cerr << "Number of codes exceeds number of factors (";
-  cerr << get_factors() << ") in line " << l+1 << endl;
+  if(!quiet){
+   cerr << "Number of codes exceeds number of factors (";
+   cerr << get_factors() << ") in line " << l+1 << endl;
+  }
   #endif
   return false;
  }
@@ -329,18 +591,56 @@ bool data::add_value(int fact, double val, int l)
   cout << " is less than the number of factors (";
   cout << get_factors() << ")" << "<p>" << endl;
   #else
-  cerr << "Number of codes in line " << l+1;
-  cerr << " is less than the number of factors (";
-  cerr << get_factors() << ")" << endl;
+  if(!quiet){
+   cerr << "Number of codes in line " << l+1;
+   cerr << " is less than the number of factors (";
+   cerr << get_factors() << ")" << endl;
+  }
   #endif
   return false;
  } 
- add_code_line(code_line,val);		 // Add 'code_line' to the list
+ #ifndef CGI
+ if(cands) add_candidates(code_line,val);	 // Compare transformations
+ if(kernel&&!rows&&!split){		 // Transform it later, in a batch
+  if(!batchvalues){
+   batchcodes = new LEVCODES[TRANSBATCH];
+   batchvalues = new double[TRANSBATCH];
+  }
+  memcpy(batchcodes[nbatch],code_line,sizeof(LEVCODES));
+  batchvalues[nbatch++]=val;
+  if(nbatch==TRANSBATCH) flush_batch();
+ }
+ else
+ #endif
+ add_observation(code_line,val);
  memset(code_line,0,sizeof(code_line));  // Clear 'code_line'
  nt++;					 // Increment number of replicates
  return true;
 }
 
+//------------------------------------------------------------------------//
+// This function adds an observation with level codes 'cline' and value   //
+// 'val' to wherever observations go while reading this data file.        //
+//------------------------------------------------------------------------//
+
+void data::add_observation(LEVCODES cline, double val)
+{
+ #ifndef CGI
+ if(shared){				 // Add it to the shared cells...
+  shared_add(cline,val,pow(val,2),1);
+ }
+ else if(!rows&&pipeline()){		 // ...pass it to another thread...
+  if(!ringbuf) start_pipeline();
+  pass_value(cline,val);
+ }
+ else if(win) add_window(cline,val);	 // ...slide the window...
+ else if(split) add_split(cline,val);	 // ...add it to its group...
+ else
+ #endif
+ if(rows) add_row(cline,val);		 // ...keep the observation...
+ else add_code_line(cline,val);		 // ...or add 'cline' to the list
+}
+
 //------------------------------------------------------------------------//
 // This function returns the number of factors in the analysis            //
 //------------------------------------------------------------------------//
@@ -421,7 +721,7 @@ const char *data::get_code_name(int factnum, int levnum)
 {
  if((factnum>=0)&&(factnum<factors)){
   if((levnum>=0)&&(levnum<levels[factnum])){  
-   return code_name[factnum][levnum];
+   return code_name[factnum].names[levnum];
   }
  }
  return "";
@@ -437,7 +737,7 @@ const char *data::get_orig_code_name(int factnum, int levnum)
 {
  if((factnum>=0)&&(factnum<factors)){
   if((levnum>=0)&&(levnum<origlevels[factnum])){  
-   return code_name[factnum][levnum];
+   return code_name[factnum].names[levnum];
   }
  }
  return "";
@@ -472,137 +772,59 @@ int data::is_nested(int fact1)
 // combination of factors. Variable 'cline' is an array with 1s in each   //
 // cell that corresponds to a factor being analyzed. Thus [1001000] means //
 // that factors 0 and 3 are being considered and the partial SS is an     //
-// interaction SS. The list of partials is searched for different         //
-// combinations of levels of the factors involved. In each combination a  //
-// cumulative sum of values is stored as well as the cumulative sum of    //
-// degrees of freedom. In the end, the individual sums are squared and    //
-// summed, and finally divided by the cumulative degrees of freedom of the//
-// combinations (the df of the first combination is used, but they should //
-// be the same for all combinations). During the process a dynamic list of//
-// combinations is built and will be discarded in the end.                //
+// interaction SS. The sums of all cells with the same levels of these    //
+// factors are added up, numbering combinations of levels from the level  //
+// codes as cells are numbered in 'grid'. In the end, the individual sums //
+// are squared and summed, and divided by the number of values in each    //
+// combination (the same for all, once equalized). Cells are swept in     //
+// order, a run of levels of the last factor at a time.                   //
 //------------------------------------------------------------------------//
 
 double data::get_partial_SS(CODES cline) 
 {
- struct part{
-  CODES codes;
-  double ss;
-  double n;
-  part *next;
- };
+ double *sums,ss;
+ int    step[MAXFACTORS];
+ int    ncombins,run,rstep,c,k,j,i;
  
- double  ss,n;
- part    *firstss,*lastss,*s;
- partial *t;
- bool    equal;
- int     i;
+ if(!grid||(get_nt()==0)) return 0;
  
- firstss=NULL;
- lastss=NULL;
- ss=0;
- n=0;
-    
- // Go along list of partials partials
+ // Combinations of levels of the factors in 'cline', numbered in mixed
+ // radix as cells are, from the last factor
  
- if(first){
-  t=first;
-  do{
-   if(!firstss){     
-     
-    // No items in the list of partial SS: create!
-     
-    firstss = new part;
-    if(firstss){
-     for(i=0;i<get_factors();i++){
-      if(cline[i]>0) firstss->codes[i]=t->codes[i];
-      else firstss->codes[i]=0;
-     }
-     firstss->ss=t->sum;
-     firstss->n=t->n;
-     firstss->next=NULL;
-     lastss=firstss;
-    }
-   }
-   else{  
-     
-    // There are already items in the list of partial SS. 
-    // Find out if current 't->codes' is there...
-    
-    s=firstss;
-    do{
-     equal=true;
-     for(i=0;i<get_factors();i++){
-      if(cline[i]>0) if((s->codes[i])!=(t->codes[i])) equal=false;
-     }
-     if(!equal) s=s->next;
-    }while((s)&&(!equal));
-     
-    if(equal){
-     
-     // There is one item equal to 't->codes'! Add ss and n values to it
-     
-     s->ss+=t->sum;
-     s->n+=t->n;
-    }
-    else{
-     
-     // No item in the list is equal to current 't->codes'. 
-     //Add a new one.
-     
-     s = new part;
-     if(s){
-      for(i=0;i<get_factors();i++){
-       if(cline[i]>0) s->codes[i]=t->codes[i];
-       else s->codes[i]=0;
-      }
-      s->ss=t->sum;
-      s->n=t->n;
-      s->next=NULL;
-      lastss->next=s;
-      lastss=s;
-     }
-    }
-   }    
-   t=t->next;
-  }while(t);
-  
-  // Square all partials and sum them up, divide the total by the 
-  // degrees of freedom of one of the terms (they should be all
-  // equal) and destruct the list before returning SS!
-  
-  if(firstss){
-   s=firstss;
-   do{
-    ss+=pow(s->ss,2);
-    s=s->next;
-   }while(s);
-   
-   #ifdef DEBUG_GET_PARTIAL_SS
-   for(i=0;i<get_factors();i++) cout << (int) cline[i];
-   cout << endl;   
-   s=firstss;
-   do{
-    for(i=0;i<get_factors();i++) cout << (int) s->codes[i];
-    cout << ": " << s->ss << endl;
-    s=s->next;
-   }while(s);
-   cout << endl;
-   #endif
-   
-   // Make sure 'n' is bigger than 0
-   
-   if((firstss->n)>0) ss/=firstss->n;
-   else ss=0;
-   
-   // Destruct list of 'part's
-   do{
-    s=firstss;
-    firstss=s->next;
-    delete s;
-   }while(firstss);
+ ncombins=1;
+ for(i=get_factors()-1;i>=0;i--){
+  step[i]=(cline[i]>0)?ncombins:0;
+  if(cline[i]>0) ncombins*=get_levels(i);
+ }
+ sums = new double[ncombins];
+ memset(sums,0,ncombins*sizeof(double));
+ run=get_levels(get_factors()-1);
+ rstep=step[get_factors()-1];
+ if(grid->codes){				// Cells in a list
+  for(k=0;k<grid->ncells;k++){
+   c=0;
+   for(i=0;i<get_factors();i++) c+=grid->codes[k*get_factors()+i]*step[i];
+   sums[c]+=grid->sum[k];
   }
  }
- return ss;
+ else for(k=0;k<grid->ncells;k+=run){
+  c=0;
+  for(i=0;i<get_factors()-1;i++) if(step[i]) c+=(k/grid->stride[i])%get_levels(i)*step[i];
+  if(rstep) for(j=0;j<run;j++) sums[c+j]+=grid->sum[k+j];
+  else for(j=0;j<run;j++) sums[c]+=grid->sum[k+j];
+ }
+ ss=0;
+ for(c=0;c<ncombins;c++) ss+=pow(sums[c],2);
+ 
+ #ifdef DEBUG_GET_PARTIAL_SS
+ for(i=0;i<get_factors();i++) cout << (int) cline[i];
+ cout << endl;   
+ for(c=0;c<ncombins;c++) cout << c << ": " << sums[c] << endl;
+ cout << endl;
+ #endif
+ 
+ delete [] sums;
+ return ss/((double) get_nt()/ncombins);
 }
 
 //------------------------------------------------------------------------//
@@ -613,20 +835,14 @@ double data::get_partial_SS(CODES cline)
 
 double data::get_CT()
 {
- partial *t;
- double  sum;
+ double sum;
+ int    k;
  
- // Make sure a list of partials exists and
- // nt > 0
+ // Make sure the table of cells exists and nt > 0
  
- if(first&&(get_nt()>0)){
-  t=first;
+ if(grid&&(get_nt()>0)){
   sum=0;
-  do{
-   sum+=t->sum; 
-   t=t->next;
-  }while(t);
-  
+  for(k=0;k<grid->ncells;k++) sum+=grid->sum[k];
   sum=pow(sum,2);
   sum/=(double)nt;
   return sum;
@@ -641,16 +857,10 @@ double data::get_CT()
 
 double data::get_sum_of_squares()
 {
- double  sum=0;
- partial *t;
+ double sum=0;
+ int    k;
  
- if(first){
-  t=first;
-  do{
-   sum+=t->sum2;
-   t=t->next;
-  }while(t);
- }
+ if(grid) for(k=0;k<grid->ncells;k++) sum+=grid->sum2[k];
  return sum;
 }
 
@@ -660,16 +870,10 @@ double data::get_sum_of_squares()
 
 double data::get_error_ss()
 {
- double  sum=0;
- partial *t;
+ double sum=0;
+ int    k;
  
- if(first){
-  t=first;
-  do{
-   sum+=pow(t->sum,2);
-   t=t->next;
-  }while(t);
- }
+ if(grid) for(k=0;k<grid->ncells;k++) sum+=pow(grid->sum[k],2);
  #ifdef DEBUG_DATA
  cerr << "Error = " << get_sum_of_squares()-sum/get_error_df() << endl;
  #endif
@@ -762,6 +966,9 @@ void data::equalize()
   do{
    if(((t->n)<maxreps)&&((t->n)>0)){
     newreps=maxreps-(t->n);
+    #ifndef CGI
+    if(t->vec) equalize_responses(t,newreps);
+    #endif
     average=(t->sum)/(t->n);
     for(i=0;i<newreps;i++){
      t->sum+=average;
@@ -805,7 +1012,7 @@ void data::compute_nesting()
 {
  int     i,j,l,expected_combins,corrected;
  partial *t,*u;
- char    tc1,tc2,uc1,uc2;
+ int     tc1,tc2,uc1,uc2;
  bool    exists;
  int     combins[MAXFACTORS][MAXFACTORS];
  
@@ -938,7 +1145,7 @@ void data::recode(int f, int lev)
      r=div(j,lev);
      j=r.rem;
     } 
-    t->codes[f]=(char)j;
+    t->codes[f]=j;
     t=t->next;
    }while(t); 
   }
@@ -1034,15 +1241,103 @@ bool data::orthogonalize()
    cerr << "There are missing combinations of factor levels!<p>" << endl;
    cerr << "Bailing out!<p>" << endl;
    #else
-   cerr << "There are missing combinations of factor levels!" << endl;
-   cerr << "Bailing out!" << endl;
+   if(!quiet){
+    cerr << "There are missing combinations of factor levels!" << endl;
+    cerr << "Bailing out!" << endl;
+   }
    #endif
    return false;
   }
  }
+ return build_grid();
+}
+
+//------------------------------------------------------------------------//
+// This function builds the table of cells of an orthogonal design, with  //
+// the sums of each partial at the place given by its level codes or, if  //
+// two partials have the same codes, in the order of the list. If cells   //
+// are kept on disk ('--mem-limit') so is the table. It returns false if  //
+// the table cannot be kept on disk.                                      //
+//------------------------------------------------------------------------//
+
+bool data::build_grid()
+{
+ partial *t;
+ bool    *used,listed;
+ int     nf,i,j,k;
+ 
+ if(grid) free_grid();
+ if(!first) return true;
+ nf=get_factors();
+ grid = new celltable;
+ grid->ncells=1;
+ for(i=nf-1;i>=0;i--){
+  grid->stride[i]=grid->ncells;
+  grid->ncells*=get_levels(i);
+ }
+ listed=false;
+ used = new bool[grid->ncells];
+ memset(used,0,grid->ncells*sizeof(bool));
+ for(t=first;t&&!listed;t=t->next){
+  k=0;
+  for(i=0;i<nf;i++) k+=t->codes[i]*grid->stride[i];
+  if(used[k]) listed=true;
+  used[k]=true;
+ }
+ delete [] used;
+ if(listed) grid->ncells=npartials;
+ grid->size=(size_t) grid->ncells*(2*sizeof(double)+(listed?2*nf+1:nf+1)*sizeof(int));
+ grid->mapped=false;
+ #ifndef CGI
+ if(spill){
+  grid->block=(char *) map_spill(grid->size);
+  if(!grid->block){
+   delete grid;
+   grid=NULL;
+   return false;
+  }
+  grid->mapped=true;
+ }
+ else
+ #endif
+ grid->block = new char[grid->size];
+ grid->sum=(double *) grid->block;
+ grid->sum2=grid->sum+grid->ncells;
+ grid->n=(int *) (grid->sum2+grid->ncells);
+ grid->orig=grid->n+grid->ncells;
+ grid->codes=listed?grid->orig+grid->ncells*nf:NULL;
+ for(t=first,j=0;t;t=t->next,j++){
+  k=j;
+  if(grid->codes){
+   memcpy(grid->codes+k*get_factors(),t->codes,get_factors()*sizeof(int));
+  }
+  else{
+   k=0;
+   for(i=0;i<get_factors();i++) k+=t->codes[i]*grid->stride[i];
+  }
+  grid->sum[k]=t->sum;
+  grid->sum2[k]=t->sum2;
+  grid->n[k]=t->n;
+  memcpy(grid->orig+k*get_factors(),t->orig,get_factors()*sizeof(int));
+ }
  return true;
 }
 
+//------------------------------------------------------------------------//
+// This function removes the table of cells                               //
+//------------------------------------------------------------------------//
+
+void data::free_grid()
+{
+ #ifndef CGI
+ if(grid->mapped) munmap(grid->block,grid->size);
+ else
+ #endif
+ delete [] grid->block;
+ delete grid;
+ grid=NULL;
+}
+
 
 //------------------------------------------------------------------------//
 // This function tests whether the data is homoscedastic or not by        //
@@ -1055,23 +1350,20 @@ void data::test_homogeneity()
  int df;
  double varmax,varmin,sumvar,var;
  double b1,b2,bc;
- partial *t;
+ int    k;
  
  sumvar=varmax=b1=b2=0;
  df=0;
- if(first){
-  t=first;
-  varmin=(t->sum2-(pow(t->sum,2)/t->n))/(t->n-1);
-  do{
-   var=(t->sum2-(pow(t->sum,2)/t->n))/(t->n-1);
+ if(grid){
+  varmin=(grid->sum2[0]-(pow(grid->sum[0],2)/grid->n[0]))/(grid->n[0]-1);
+  for(k=0;k<grid->ncells;k++){
+   var=(grid->sum2[k]-(pow(grid->sum[k],2)/grid->n[k]))/(grid->n[k]-1);
    sumvar+=var;
-   t->var=var;
    if(var>varmax) varmax=var;
    if(varmin>var) varmin=var;
-   df+=(t->n-1);
-   b2+=(t->n-1)*log(var);
-   t=t->next;
-  }while(t);
+   df+=(grid->n[k]-1);
+   b2+=(grid->n[k]-1)*log(var);
+  }
   
   b1=log(sumvar);
   bc=1+1/(3*(npartials-1))*(npartials/(get_n()-1)*1/(df));
@@ -1146,102 +1438,1007 @@ double data::transform(double v)
 
 #ifndef CGI
 //------------------------------------------------------------------------//
-// This function reads a anova file. anova files should be in columnar    //
-// format, with the last column being the data values. The first line     //
-// have the names of the factors, each one with an optional '*' character //
-// in the end to be treated as a random factor. Comment lines starting    //
-// with an '#' are ignored.                                               //
+// Tokens in data files are separated by any number of the delimiters     //
+// ' ', '\t', ':', ';', ',' and '\r'. This function returns a bit mask    //
+// with a 1 for each delimiter among the 'len' (up to 64) bytes at 'p'.   //
+// Blocks of 64 bytes are scanned with AVX2 or SSE2 instructions if the   //
+// compiler targets them, otherwise (and for the end of a line, which is  //
+// not read beyond 'p+len') byte by byte.                                 //
 //------------------------------------------------------------------------//
 
-bool data::read_data()
+static inline bool is_delimiter(char c)
+{
+ return (c==' ')||(c=='\t')||(c==':')||(c==';')||(c==',')||(c=='\r');
+}
+
+#if defined(__AVX2__)
+static inline uint64_t delimiter_mask32(const char *p)
 {
- int		fact,lines;
- ifstream 	df;
- char		string[1000];
- char		*token, temp[100];
- bool		header=true;
- char		delimiters[] = " \t:;,";
- double		v;
+ __m256i c,m;
  
- lines=0;
- if(strlen(data_file_name())>0){
-  df.open(data_file_name());
-  if(df){				// Read from data file
-   df.getline(string,1000);
-   while(!df.eof()){      
-    if((strchr(string,'#')==NULL)&&(strlen(string)>0)){
-     if(header){			
-      token=strtok(string,delimiters);
-      do{
-       strcpy(temp,token);
-       token=strtok(NULL,delimiters);
-       if(token!=NULL) if(!set_factor(temp)) return false;
-       else set_data_name(temp);
-      }while(token!=NULL);
-      header=false;				      
-     }
-     else{
-      fact=0;
-      token=strtok(string,delimiters);
-      do{
-       strcpy(temp,token);
-       token=strtok(NULL,delimiters);
-       if(token!=NULL){
-        if(!add_code(fact,temp,lines)) return false; 
-	else fact++;
-       }
-       else{
-        v=transform((double) atof(temp));
-        if(!add_value(fact,v,lines)) return false;	
-       }
-      }while(token!=NULL);
-     }                
+ c=_mm256_loadu_si256((const __m256i *) p);
+ m=_mm256_cmpeq_epi8(c,_mm256_set1_epi8(' '));
+ m=_mm256_or_si256(m,_mm256_cmpeq_epi8(c,_mm256_set1_epi8('\t')));
+ m=_mm256_or_si256(m,_mm256_cmpeq_epi8(c,_mm256_set1_epi8(':')));
+ m=_mm256_or_si256(m,_mm256_cmpeq_epi8(c,_mm256_set1_epi8(';')));
+ m=_mm256_or_si256(m,_mm256_cmpeq_epi8(c,_mm256_set1_epi8(',')));
+ m=_mm256_or_si256(m,_mm256_cmpeq_epi8(c,_mm256_set1_epi8('\r')));
+ return (uint32_t) _mm256_movemask_epi8(m);
+}
+#elif defined(__SSE2__)
+static inline uint64_t delimiter_mask16(const char *p)
+{
+ __m128i c,m;
+ 
+ c=_mm_loadu_si128((const __m128i *) p);
+ m=_mm_cmpeq_epi8(c,_mm_set1_epi8(' '));
+ m=_mm_or_si128(m,_mm_cmpeq_epi8(c,_mm_set1_epi8('\t')));
+ m=_mm_or_si128(m,_mm_cmpeq_epi8(c,_mm_set1_epi8(':')));
+ m=_mm_or_si128(m,_mm_cmpeq_epi8(c,_mm_set1_epi8(';')));
+ m=_mm_or_si128(m,_mm_cmpeq_epi8(c,_mm_set1_epi8(',')));
+ m=_mm_or_si128(m,_mm_cmpeq_epi8(c,_mm_set1_epi8('\r')));
+ return (uint16_t) _mm_movemask_epi8(m);
+}
+#endif
+
+static inline uint64_t delimiter_mask(const char *p, int len)
+{
+ uint64_t m=0;
+ int      i;
+ 
+ if(len==64){
+  #if defined(__AVX2__)
+  return delimiter_mask32(p)|(delimiter_mask32(p+32)<<32);
+  #elif defined(__SSE2__)
+  return delimiter_mask16(p)|(delimiter_mask16(p+16)<<16)|
+         (delimiter_mask16(p+32)<<32)|(delimiter_mask16(p+48)<<48);
+  #endif
+ }
+ for(i=0;i<len;i++) if(is_delimiter(p[i])) m|=((uint64_t) 1)<<i;
+ return m;
+}
+
+//------------------------------------------------------------------------//
+// This function splits the line between 's' and 'e' into tokens, which   //
+// are stored (as views into the line, nothing is copied) in 'tokens'.    //
+// For each block of 64 bytes the bit masks of the first byte of a token  //
+// ('starts') and of the delimiter after a token ('ends') are derived     //
+// from the mask of delimiters. Splitting stops after 'limit' tokens, so  //
+// the rest of the line is not even scanned. It returns the number of     //
+// tokens.                                                                //
+//------------------------------------------------------------------------//
+
+int data::split_line(const char *s, const char *e, int limit)
+{
+ string_view *t;
+ const char  *p,*start;
+ uint64_t    d,nd,starts,ends,valid,carry,bit;
+ int         len,ntokens,i;
+ 
+ ntokens=0;
+ start=NULL;
+ carry=1;			// The byte before the line is a delimiter
+ for(p=s;p<e;p+=64){
+  len=(e-p<64)?(int) (e-p):64;
+  valid=(len==64)?~((uint64_t) 0):((((uint64_t) 1)<<len)-1);
+  d=delimiter_mask(p,len);
+  nd=~d&valid;
+  starts=nd&((d<<1)|carry);
+  ends=d&((nd<<1)|(carry^1));
+  carry=(d>>63)&1;
+  if(len<64) carry=1;
+  while(starts|ends){
+   bit=(starts|ends)&(~(starts|ends)+1);
+   i=__builtin_ctzll(bit);
+   if(starts&bit){
+    start=p+i;
+    starts^=bit;
+   }
+   else{
+    if(ntokens==maxtokens){
+     t = new string_view[2*maxtokens+16];
+     for(len=0;len<ntokens;len++) t[len]=tokens[len];
+     if(tokens) delete [] tokens;
+     tokens=t;
+     maxtokens=2*maxtokens+16;
     }
-    lines++;
-    df.getline(string,1000);
-   }                                        
-   df.close();
+    tokens[ntokens++]=string_view(start,p+i-start);
+    if(ntokens==limit) return ntokens;
+    start=NULL;
+    ends^=bit;
+   }
   }
-  else {
-   cerr << "Error while opening " << data_file_name() << "!... Exiting..." << endl;
+ }
+ if(start){			// The last token ends with the line
+  if(ntokens==maxtokens){
+   t = new string_view[2*maxtokens+16];
+   for(len=0;len<ntokens;len++) t[len]=tokens[len];
+   if(tokens) delete [] tokens;
+   tokens=t;
+   maxtokens=2*maxtokens+16;
+  }
+  tokens[ntokens++]=string_view(start,e-start);
+ }
+ return ntokens;
+}
+
+//------------------------------------------------------------------------//
+// This function converts the token 'tk' into a number. Numbers are read  //
+// with std::from_chars, which does not depend on the locale; anything it //
+// does not fully read (e.g. a leading '+') is passed on to atof().       //
+//------------------------------------------------------------------------//
+
+double data::token_value(string_view tk)
+{
+ double          v;
+ from_chars_result r;
+ char            temp[101];
+ size_t          len;
+ 
+ r=from_chars(tk.data(),tk.data()+tk.size(),v);
+ if((r.ec==errc())&&(r.ptr==tk.data()+tk.size())) return v;
+ len=(tk.size()>100)?100:tk.size();
+ memcpy(temp,tk.data(),len);
+ temp[len]=0;
+ return atof(temp);
+}
+
+//------------------------------------------------------------------------//
+// This function adds a line of a summary data file to the cell with the  //
+// level codes in 'code_line': 'count' replicates with sum 'a' and sum of //
+// squares 'b' (SUMDATA) or with mean 'a' and variance 'b' (MEANDATA).    //
+// Several lines of the same cell are pooled.                             //
+//------------------------------------------------------------------------//
+
+bool data::add_summary(double count, double a, double b, int l)
+{
+ partial *t;
+ 
+ if((count<1)||(count!=floor(count))||((stats==MEANDATA)&&(b<0))){
+  if(!quiet){
+   cerr << "Invalid number of replicates or variance in line " << l+1 << endl;
+  }
+  return false;
+ }
+ if(stats==MEANDATA){
+  b=(count-1)*b+count*a*a;
+  a=count*a;
+ }
+ if(shared) shared_add(code_line,a,b,(int) count);
+ else{
+  t=get_partial(code_line);
+  t->sum+=a;
+  t->sum2+=b;
+  t->n+=(int) count;
+ }
+ nt+=(int) count;
+ memset(code_line,0,sizeof(code_line));
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function tells if the line just split passes all the filters set  //
+// with '--where'. Each filter costs a lookup of the value of its column  //
+// among the literals of the predicates and a bit test, plus a number     //
+// conversion if values are compared with numbers.                       //
+//------------------------------------------------------------------------//
+
+bool data::accept_line()
+{
+ filter *f;
+ double v;
+ int    i,k;
+ 
+ for(i=0;i<nfilters;i++){
+  f=&filters[i];
+  if(f->literals.nnames>0){
+   k=find_name(&f->literals,tokens[f->col]);
+   if(k<0){
+    if(!f->other) return false;
+   }
+   else if(!((f->accept[k>>5]>>(k&31))&1)) return false;
+  }
+  if(f->ranged){
+   v=token_value(tokens[f->col]);
+   if((v<f->min)||((v==f->min)&&!f->mininc)) return false;
+   if((v>f->max)||((v==f->max)&&!f->maxinc)) return false;
+  }
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function parses a single line of a data file, lying between 's'   //
+// and 'e' (the newline is not included). The line is tokenized in place //
+// so it may point directly into a memory mapped file. The first line     //
+// have the names of the factors and of the data variable, all other      //
+// lines have level codes followed by a data value. Comment lines (with   //
+// an '#') and empty lines are ignored.                                   //
+//------------------------------------------------------------------------//
+
+bool data::parse_line(const char *s, const char *e)
+{
+ char	temp[101];
+ int	fact,ntokens,len;
+ double	v;
+ 
+ if((s==e)||(memchr(s,'#',e-s)!=NULL)) return true;
+ ntokens=split_line(s,e,(in_header||(datacol<0))?0:ncols);
+ if(ntokens==0) return true;		// Only delimiters in this line
+ 
+ if(in_header){
+  in_header=false;
+  if(!find_stats(ntokens)) return false;
+  if((stats!=RAWDATA)||projected()){
+   if(!project_columns(ntokens)) return false;
+  }
+  else{
+  
+   // The last token in the line is the data name
+   
+   for(fact=0;fact<ntokens;fact++){
+    len=(tokens[fact].size()>100)?100:tokens[fact].size();
+    memcpy(temp,tokens[fact].data(),len);
+    temp[len]=0;
+    if(fact<(ntokens-1)){
+     if(!set_factor(temp)) return false;
+    }
+    else set_data_name(temp);
+   }
+  }
+  if(shared) return check_header();	// One of several data files
+ }
+ else if(datacol>=0){
+ 
+  // Only the selected columns are read
+  
+  if(ntokens<ncols){
+   if(!quiet){
+    cerr << "Number of columns in line " << lines+1;
+    cerr << " is less than the number of selected columns (" << ncols << ")" << endl;
+   }
+   return false;
+  }
+  if(nfilters&&!accept_line()) return true;	// Rejected by '--where'
+  if(split) split->group=add_name(&split->names,tokens[split->col]);
+  for(fact=0;fact<get_factors();fact++){
+   if(!add_code(fact,tokens[factcol[fact]],lines)) return false;
+  }
+  if(stats!=RAWDATA){
+   return add_summary(token_value(tokens[statcol[0]]),token_value(tokens[statcol[1]]),
+                      token_value(tokens[statcol[2]]),lines);
+  }
+  if(resp){
+   add_responses();
+   return true;
+  }
+  v=token_value(tokens[datacol]);
+  if(!add_value(fact,v,lines)) return false;
+ }
+ else{
+ 
+  // The last token in the line is the data value
+  
+  for(fact=0;fact<(ntokens-1);fact++){
+   if(!add_code(fact,tokens[fact],lines)) return false;
+  }
+  v=token_value(tokens[ntokens-1]);
+  if(!add_value(fact,v,lines)) return false;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the number of the column named 'name' among the  //
+// 'ntokens' names of the header line, or -1 if there is none. A '*' at   //
+// the end of names (random factors) is ignored.                          //
+//------------------------------------------------------------------------//
+
+int data::find_column(string_view name, int ntokens)
+{
+ string_view h;
+ int         i;
+ 
+ if((name.size()>0)&&(name.back()=='*')) name.remove_suffix(1);
+ for(i=0;i<ntokens;i++){
+  h=tokens[i];
+  if((h.size()>0)&&(h.back()=='*')) h.remove_suffix(1);
+  if(h==name) return i;
+ }
+ return -1;
+}
+
+//------------------------------------------------------------------------//
+// This function returns which statistic the header name 'h' names (in    //
+// any case), either alone or following the name of the data variable and //
+// a dot, as in 'mean' or 'Biomass.mean': 0 for 'n', 1 for 'sum', 2 for   //
+// 'sumsq', 3 for 'mean' and 4 for 'var', or -1 if none. The name before  //
+// the statistic, if any, is left in 'prefix'.                            //
+//------------------------------------------------------------------------//
+
+static int stat_name(string_view h, string_view &prefix)
+{
+ static const char *names[5]={"n","sum","sumsq","mean","var"};
+ size_t len;
+ int    k;
+ 
+ for(k=0;k<5;k++){
+  len=strlen(names[k]);
+  if(h.size()<len) continue;
+  if((h.size()>len)&&(h[h.size()-len-1]!='.')) continue;
+  if(strncasecmp(h.data()+h.size()-len,names[k],len)==0){
+   prefix=h.substr(0,(h.size()>len)?h.size()-len-1:0);
+   return k;
+  }
+ }
+ return -1;
+}
+
+//------------------------------------------------------------------------//
+// This function checks if the 'ntokens' names of the header line are     //
+// those of a summary data file, which has one line per combination of    //
+// factor levels with the number of replicates ('n') and either their     //
+// sum and sum of squares ('sum' and 'sumsq') or their mean and variance  //
+// ('mean' and 'var'), and sets 'stats' and 'statcol' accordingly.        //
+//                                                                        //
+// Factors and responses may also have such names, so with '--response'   //
+// or '--responses' the file holds raw data, and without '--summary' it   //
+// is only a summary data file if its last three columns are a complete   //
+// set of statistics of the same data variable. A header which ends with  //
+// some statistics but not a complete set is an error, as is a summary    //
+// data file ('--summary') without one. It returns false on errors.       //
+//------------------------------------------------------------------------//
+
+bool data::find_stats(int ntokens)
+{
+ string_view prefix[5],p;
+ int         i,k,col[5],first,found;
+ bool        complete;
+ 
+ stats=RAWDATA;
+ if(!summary_data()&&((strlen(response_name())>0)||resp)) return true;
+ 
+ // Without '--summary' only the names at the end of the header count
+ 
+ first=0;
+ if(!summary_data()){
+  for(first=ntokens;(first>0)&&(stat_name(tokens[first-1],p)>=0);first--);
+ }
+ for(k=0;k<5;k++) col[k]=-1;
+ found=0;
+ complete=true;
+ for(i=first;i<ntokens;i++){
+  k=stat_name(tokens[i],p);
+  if(k<0) continue;
+  if(col[k]>=0) complete=false;		// The same statistic twice
+  col[k]=i;
+  prefix[k]=p;
+  found++;
+ }
+ if(found==0) return true;
+ if(complete&&(found==3)&&(col[0]>=0)){
+  if((col[1]>=0)&&(col[2]>=0)&&(prefix[1]==prefix[0])&&(prefix[2]==prefix[0])){
+   stats=SUMDATA;
+   statcol[1]=col[1];
+   statcol[2]=col[2];
+  }
+  else if((col[3]>=0)&&(col[4]>=0)&&(prefix[3]==prefix[0])&&(prefix[4]==prefix[0])){
+   stats=MEANDATA;
+   statcol[1]=col[3];
+   statcol[2]=col[4];
+  }
+  statcol[0]=col[0];
+ }
+ if(stats!=RAWDATA) return true;
+ if(!summary_data()&&(found==1)) return true;	// e.g. a response 'Mean'
+ cerr << "The header of " << data_file_name() << " has an incomplete or ambiguous set of statistics:" << endl;
+ cerr << "summary data files need n and either sum and sumsq or mean and var";
+ if(!summary_data()) cerr << " as their last columns (or --summary), or give --response to read raw data";
+ cerr << "!... Exiting..." << endl;
+ return false;
+}
+
+//------------------------------------------------------------------------//
+// This function selects the columns given with '--factors' and          //
+// '--response' from the 'ntokens' names of the header line. Factors are  //
+// set in the order they are listed, and are random if their name ends    //
+// with a '*' either in the list or in the header. Without '--factors'    //
+// all columns but the response are factors, and without '--response' the//
+// response is the last column. In summary data files the statistics     //
+// take the place of the response. Only the first 'ncols' columns of data //
+// lines, up to the last selected one, will be split.                     //
+//------------------------------------------------------------------------//
+
+bool data::project_columns(int ntokens)
+{
+ const char  *list,*p;
+ char        temp[101];
+ string_view name;
+ int         col,len,i;
+ 
+ // Response, or statistics of summary data files (the data name is the
+ // one before the dot in the name of the column of replicates, if any)
+ 
+ if(stats!=RAWDATA){
+  if((strlen(response_name())>0)||resp){
+   cerr << "A response cannot be selected in summary data files!... Exiting..." << endl;
    return false;
   }
+  if((pretransform()!=NOTRANSF)||(transformation()!=NOTRANSF)||cands){
+   cerr << "Summary data files cannot be transformed!... Exiting..." << endl;
+   return false;
+  }
+  if(rows){
+   cerr << "Summary data files cannot be converted!... Exiting..." << endl;
+   return false;
+  }
+  if(split){
+   cerr << "Summary data files cannot be split!... Exiting..." << endl;
+   return false;
+  }
+  datacol=statcol[0];
+  name=tokens[datacol];
+  name.remove_suffix(1);
+  if(name.size()>0) name.remove_suffix(1);
+  else name="DATA";
+  len=(name.size()>100)?100:name.size();
+  memcpy(temp,name.data(),len);
+  temp[len]=0;
+  set_data_name(temp);
+  ncols=0;
+  for(i=0;i<3;i++) if(statcol[i]+1>ncols) ncols=statcol[i]+1;
+ }
+ else{
+  if(strlen(response_name())>0){
+   datacol=find_column(response_name(),ntokens);
+   if(datacol<0){
+    cerr << "Column " << response_name() << " not found in the header!... Exiting..." << endl;
+    return false;
+   }
+  }
+  else if(resp){
+   if(!name_responses(ntokens)) return false;
+  }
+  else datacol=ntokens-1;
+  len=(tokens[datacol].size()>100)?100:tokens[datacol].size();
+  memcpy(temp,tokens[datacol].data(),len);
+  temp[len]=0;
+  set_data_name(temp);
+  ncols=datacol+1;
+  if(resp) ncols=ntokens;
+ }
+ 
+ // Column of groups
+ 
+ if(split){
+  split->col=find_column(split_by(),ntokens);
+  if(split->col<0){
+   cerr << "Column " << split_by() << " not found in the header!... Exiting..." << endl;
+   return false;
+  }
+  if(split->col+1>ncols) ncols=split->col+1;
+ }
+ 
+ // Factors
+ 
+ list=factor_list();
+ if(strlen(list)>0){
+  while(*list){
+   p=strchr(list,',');
+   if(!p) p=list+strlen(list);
+   name=string_view(list,p-list);
+   list=(*p)?p+1:p;
+   if(name.size()==0) continue;
+   col=find_column(name,ntokens);
+   if(col<0){
+    cerr << "Column " << name << " not found in the header!... Exiting..." << endl;
+    return false;
+   }
+   if(get_factors()<MAXFACTORS) factcol[get_factors()]=col;
+   len=(tokens[col].size()>100)?100:tokens[col].size();
+   memcpy(temp,tokens[col].data(),len);
+   temp[len]=0;
+   if(!set_factor(temp)) return false;
+   if(name.back()=='*') set_factor_type(get_factors()-1,RANDOM);
+   if(col+1>ncols) ncols=col+1;
+  }
+ }
+ else{
+  for(col=0;col<ntokens;col++){
+   if(col==datacol) continue;
+   if(resp&&(col>datacol)) continue;		// All responses are last
+   if(split&&(col==split->col)) continue;
+   if((stats!=RAWDATA)&&((col==statcol[1])||(col==statcol[2]))) continue;
+   if(get_factors()<MAXFACTORS) factcol[get_factors()]=col;
+   len=(tokens[col].size()>100)?100:tokens[col].size();
+   memcpy(temp,tokens[col].data(),len);
+   temp[len]=0;
+   if(!set_factor(temp)) return false;
+  }
+  ncols=ntokens;
  }
- else{ 			            // Read data from standard input
-  cin.getline(string,1000);
-  while(!cin.eof()){      
-   if((strchr(string,'#')==NULL)&&(strlen(string)>0)){
-    if(header){			
-     token=strtok(string,delimiters);
-     do{
-      strcpy(temp,token);
-      token=strtok(NULL,delimiters);
-      if(token!=NULL) if(!set_factor(temp)) return false;
-      else set_data_name(temp);
-     }while(token!=NULL);
-     header=false;				      
+ 
+ // Filters
+ 
+ if(strlen(where_clause())>0){
+  if(!compile_where(ntokens)) return false;
+  for(col=0;col<nfilters;col++){
+   if(filters[col].col+1>ncols) ncols=filters[col].col+1;
+  }
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function returns the filter on column 'col', adding a new filter  //
+// (which accepts every row) if there is none yet.                        //
+//------------------------------------------------------------------------//
+
+filter *data::get_filter(int col)
+{
+ filter *f;
+ int    i;
+ 
+ for(i=0;i<nfilters;i++) if(filters[i].col==col) return &filters[i];
+ f = new filter[nfilters+1];
+ if(filters){
+  memcpy(f,filters,nfilters*sizeof(filter));
+  delete [] filters;
+ }
+ filters=f;
+ f=&filters[nfilters++];
+ memset(f,0,sizeof(filter));
+ f->col=col;
+ f->other=true;
+ f->min=-HUGE_VAL;
+ f->max=HUGE_VAL;
+ f->mininc=true;
+ f->maxinc=true;
+ return f;
+}
+
+// Kinds of tokens in the predicates of '--where'
+
+enum{WHERE_END,WHERE_WORD,WHERE_OP,WHERE_OPEN,WHERE_COMMA,WHERE_CLOSE};
+
+//------------------------------------------------------------------------//
+// This function reads the next token of the predicates of '--where' at   //
+// 'p' into 'tk', advancing 'p', and returns its kind. Words may be       //
+// quoted with ' or " to hold any other character.                        //
+//------------------------------------------------------------------------//
+
+static int where_token(const char *&p, string_view &tk)
+{
+ const char *s;
+ char       q;
+ 
+ while(isspace((unsigned char) *p)) p++;
+ s=p;
+ tk=string_view(s,0);
+ switch(*p){
+  case 0  : return WHERE_END;
+  case '(': p++; return WHERE_OPEN;
+  case ',': p++; return WHERE_COMMA;
+  case ')': p++; return WHERE_CLOSE;
+  case '\'':
+  case '"': q=*p++;
+            s=p;
+            while(*p&&(*p!=q)) p++;
+            tk=string_view(s,p-s);
+            if(*p) p++;
+            return WHERE_WORD;
+ }
+ if(strchr("=!<>",*p)){
+  while(*p&&strchr("=!<>",*p)) p++;
+  tk=string_view(s,p-s);
+  return WHERE_OP;
+ }
+ while(*p&&!isspace((unsigned char) *p)&&!strchr("=!<>(),'\"",*p)) p++;
+ tk=string_view(s,p-s);
+ return WHERE_WORD;
+}
+
+static inline bool is_keyword(string_view tk, const char *kw)
+{
+ return (tk.size()==strlen(kw))&&(strncasecmp(tk.data(),kw,tk.size())==0);
+}
+
+//------------------------------------------------------------------------//
+// This function compiles the predicates given with '--where' into one    //
+// filter per column, using the 'ntokens' names of the header line.       //
+// Predicates are joined with 'and' and may be                            //
+//                                                                        //
+//   Column = value          Column != value                              //
+//   Column in (v1,v2,...)   Column not in (v1,v2,...)                    //
+//   Column < number         (also <=, > and >=)                          //
+//                                                                        //
+// Values are compared as level names, numbers as data values. The        //
+// predicates are read twice: first to collect the literals of each       //
+// column, so the bitmaps of accepted literals can be sized, and then to  //
+// clear in these bitmaps the literals each predicate rejects.            //
+//------------------------------------------------------------------------//
+
+bool data::compile_where(int ntokens)
+{
+ const char   *p;
+ string_view  tk,op;
+ filter       *f;
+ unsigned int *listed;
+ char         *end,temp[101];
+ double       v;
+ int          pass,type,col,k,words,maxwords,len;
+ bool         negate;
+ 
+ listed=NULL;
+ maxwords=0;
+ for(pass=0;pass<2;pass++){
+  if(pass==1){
+   for(k=0;k<nfilters;k++){
+    words=(filters[k].literals.nnames+31)/32;
+    if(words>maxwords) maxwords=words;
+    filters[k].accept = new unsigned int[words+1];
+    memset(filters[k].accept,0xff,(words+1)*sizeof(unsigned int));
+   }
+   listed = new unsigned int[maxwords+1];
+  }
+  p=where_clause();
+  type=where_token(p,tk);
+  while(type!=WHERE_END){
+  
+   // Column
+   
+   if(type!=WHERE_WORD) goto bad;
+   col=find_column(tk,ntokens);
+   if(col<0){
+    cerr << "Column " << tk << " not found in the header!... Exiting..." << endl;
+    if(listed) delete [] listed;
+    return false;
+   }
+   f=get_filter(col);
+   if(pass==1) memset(listed,0,(maxwords+1)*sizeof(unsigned int));
+   
+   // Operator and values
+   
+   type=where_token(p,op);
+   negate=false;
+   if((type==WHERE_WORD)&&is_keyword(op,"not")){
+    negate=true;
+    type=where_token(p,op);
+    if((type!=WHERE_WORD)||!is_keyword(op,"in")) goto bad;
+   }
+   if((type==WHERE_WORD)&&is_keyword(op,"in")){
+    if(where_token(p,tk)!=WHERE_OPEN) goto bad;
+    do{
+     if(where_token(p,tk)!=WHERE_WORD) goto bad;
+     k=(pass==0)?add_name(&f->literals,tk):find_name(&f->literals,tk);
+     if(pass==1) listed[k>>5]|=1u<<(k&31);
+     type=where_token(p,tk);
+    }while(type==WHERE_COMMA);
+    if(type!=WHERE_CLOSE) goto bad;
+   }
+   else if(type!=WHERE_OP) goto bad;
+   else if((op=="=")||(op=="==")||(op=="!=")||(op=="<>")){
+    negate=(op=="!=")||(op=="<>");
+    if(where_token(p,tk)!=WHERE_WORD) goto bad;
+    k=(pass==0)?add_name(&f->literals,tk):find_name(&f->literals,tk);
+    if(pass==1) listed[k>>5]|=1u<<(k&31);
+   }
+   else if((op=="<")||(op=="<=")||(op==">")||(op==">=")){
+    if(where_token(p,tk)!=WHERE_WORD) goto bad;
+    len=(tk.size()>100)?100:tk.size();
+    memcpy(temp,tk.data(),len);
+    temp[len]=0;
+    v=strtod(temp,&end);
+    if((len==0)||(*end!=0)) goto bad;
+    if(pass==1){
+     f->ranged=true;
+     if((op[0]=='<')&&((v<f->max)||((v==f->max)&&(op.size()==1)))){
+      f->max=v;
+      f->maxinc=(op.size()==2);
+     }
+     if((op[0]=='>')&&((v>f->min)||((v==f->min)&&(op.size()==1)))){
+      f->min=v;
+      f->mininc=(op.size()==2);
+     }
     }
-    else{
-     fact=0;
-     token=strtok(string,delimiters);
-     do{
-      strcpy(temp,token);
-      token=strtok(NULL,delimiters);
-      if(token!=NULL){
-       if(!add_code(fact,temp,lines)) return false; 
-       else fact++;
-      }
-      else{
-       v=transform((double) atof(temp));
-       if(!add_value(fact,v,lines)) return false;	
-      }
-     }while(token!=NULL);
-    }                
+    type=where_token(p,tk);
+    goto next;
+   }
+   else goto bad;
+   
+   // Rows pass if their value is listed, or if it is not for 'not in'
+   // and '!=', so all other values are rejected or remain as they were
+   
+   if(pass==1){
+    words=(f->literals.nnames+31)/32;
+    for(k=0;k<words;k++){
+     if(negate) f->accept[k]&=~listed[k];
+     else f->accept[k]&=listed[k];
+    }
+    if(!negate) f->other=false;
    }
+   type=where_token(p,tk);
+   
+   next:
+   if(type==WHERE_END) break;
+   if((type!=WHERE_WORD)||!is_keyword(tk,"and")) goto bad;
+   type=where_token(p,tk);
+   if(type==WHERE_END) goto bad;
+  }
+ }
+ if(listed) delete [] listed;
+ return true;
+ 
+ bad:
+ cerr << "Invalid predicate in '" << where_clause() << "'";
+ cerr << " near '" << tk.data() << "'!... Exiting..." << endl;
+ if(listed) delete [] listed;
+ return false;
+}
+
+//------------------------------------------------------------------------//
+// This function parses all complete lines in the buffer between 's' and  //
+// 'e'. If 'eof' is true the last line needs no newline. It returns a     //
+// pointer to the first byte not parsed (an incomplete line which must be //
+// parsed when more data arrives, or the line after the one which brought //
+// 'nt' to 'parse_until') or NULL if an error was found.                  //
+//------------------------------------------------------------------------//
+
+const char *data::parse_lines(const char *s, const char *e, bool eof)
+{
+ const char *nl;
+ 
+ while(s<e){
+  nl=(const char *) memchr(s,'\n',e-s);
+  if(!nl){
+   if(!eof) break;
+   nl=e;
+  }
+  linekey=keybase+lines;
+  if(!parse_line(s,nl)) return NULL;
+  lines++;
+  s=nl+1;
+  if(parse_until&&(nt>=parse_until)) break;
+ }
+ if(nbatch) flush_batch();		// Values of the lines parsed
+ return (s<e)?s:e;
+}
+
+//------------------------------------------------------------------------//
+// This function parses the buffer between 's' and 'e' like parse_lines.  //
+// Lines going to tables shared by several threads are parsed in pieces   //
+// of about PARCHUNK bytes, after room for as many new levels and cells   //
+// as lines in the piece has been reserved in the tables. The header is   //
+// parsed first, line by line, since room can only be reserved once the   //
+// number of factors is known.                                            //
+//------------------------------------------------------------------------//
+
+const char *data::parse_buffer(const char *s, const char *e, bool eof)
+{
+ const char *nl,*c,*r;
+ int        rows;
+ 
+ if(!shared) return parse_lines(s,e,eof);
+ while(in_header&&(s<e)){
+  nl=(const char *) memchr(s,'\n',e-s);
+  c=nl?(nl+1):e;
+  r=parse_lines(s,c,eof);
+  if((r==NULL)||(r<c)) return r;
+  s=c;
+ }
+ while(s<e){
+  c=(e-s>PARCHUNK)?s+PARCHUNK:e;
+  if(c<e){
+   nl=(const char *) memchr(c,'\n',e-c);
+   c=nl?(nl+1):e;
+  }
+  rows=1;
+  for(nl=s;(nl=(const char *) memchr(nl,'\n',c-nl))!=NULL;nl++) rows++;
+  reserve_shared(rows);
+  chunkkey=keybase+lines;
+  r=parse_lines(s,c,eof);
+  release_shared(rows);
+  if((r==NULL)||(r<c)) return r;
+  s=c;
+ }
+ return e;
+}
+
+//------------------------------------------------------------------------//
+// This function reads a data file of 'size' bytes which is open in 'fd'  //
+// by mapping it into memory. Lines are parsed directly from the mapped   //
+// pages, without being copied.                                           //
+//------------------------------------------------------------------------//
+
+bool data::read_mapped(int fd, size_t size)
+{
+ void       *m;
+ const char *s,*e,*nl;
+ bool       ok;
+ int        nthreads;
+ 
+ m=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+ if(m==MAP_FAILED) return read_stream(fd);
+ madvise(m,size,MADV_SEQUENTIAL);
+ s=(const char *) m;
+ e=s+size;
+ 
+ // Binary data files start with a magic number
+ 
+ if((size>=4)&&(memcmp(s,"MWB1",4)==0)){
+  if(shared){
+   cerr << "Binary data file " << data_file_name() << " cannot be read with other data files!... Exiting..." << endl;
+   ok=false;
+  }
+  else ok=read_binary(s,e);
+  munmap(m,size);
+  return ok;
+ }
+ 
+ // ...as do Arrow IPC files...
+ 
+ if((size>=8)&&(memcmp(s,"ARROW1",6)==0)){
+  if(shared){
+   cerr << "Arrow data file " << data_file_name() << " cannot be read with other data files!... Exiting..." << endl;
+   ok=false;
+  }
+  else ok=read_arrow(s,e);
+  munmap(m,size);
+  return ok;
+ }
+ 
+ // ...and gzip compressed files with 0x1f 0x8b
+ 
+ if((size>=2)&&((unsigned char) s[0]==0x1f)&&((unsigned char) s[1]==0x8b)){
+  ok=read_gzip(-1,s,size);
+  munmap(m,size);
+  return ok;
+ }
+ 
+ // Use threads only if each one has a fair share of lines to parse
+ 
+ nthreads=(rows||pipeline()||shared||cands||resp||split||spill)?1:threads();
+ if(nthreads>(int) (size/MINCHUNK)) nthreads=size/MINCHUNK;
+ if(nthreads>1){
+ 
+  // Read the header serially, then the body in parallel
+  
+  ok=true;
+  while(ok&&in_header&&(s<e)){
+   nl=(const char *) memchr(s,'\n',e-s);
+   if(!nl) nl=e;
+   ok=parse_line(s,nl);
    lines++;
-   cin.getline(string,1000);
+   s=nl+1;
   }
- } 
+  if(ok&&(s<e)) ok=read_parallel(s,e,nthreads);
+ }
+ else ok=(parse_buffer(s,e,true)!=NULL);
+ munmap(m,size);
+ return ok;
+}
+
+//------------------------------------------------------------------------//
+// This function reads data from 'fd' (usually a pipe or the standard     //
+// input, which cannot be mapped) in large blocks. Incomplete lines at    //
+// the end of a block are moved to the beginning of the buffer and the    //
+// buffer is enlarged if a single line does not fit in it.                //
+//------------------------------------------------------------------------//
+
+bool data::read_stream(int fd)
+{
+ char       *buff,*b;
+ const char *rest;
+ size_t     size,used,len;
+ ssize_t    r;
+ bool       ok;
+ 
+ size=BLOCKSIZE;
+ used=0;
+ buff = new char[size];
+ for(;;){
+  if(used==size){
+   b = new char[2*size];
+   memcpy(b,buff,used);
+   delete [] buff;
+   buff=b;
+   size*=2;
+  }
+  r=read(fd,buff+used,size-used);
+  if(r<0){
+   if(errno==EINTR) continue;
+   cerr << "Error while reading " << data_file_name() << "!... Exiting..." << endl;
+   delete [] buff;
+   return false;
+  }
+  
+  // Compressed data is inflated by read_gzip from the first block on
+  
+  if((used==0)&&(r>=2)&&((unsigned char) buff[0]==0x1f)&&((unsigned char) buff[1]==0x8b)){
+   ok=read_gzip(fd,buff,r);
+   delete [] buff;
+   return ok;
+  }
+  rest=parse_buffer(buff,buff+used+r,r==0);
+  if(!rest){
+   delete [] buff;
+   return false;
+  }
+  if(r==0) break;
+  len=buff+used+r-rest;
+  memmove(buff,rest,len);
+  used=len;
+ }
+ delete [] buff;
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function reads the data file 'data_file_name()', or the standard  //
+// input if there is no file name. Regular files are memory mapped, while //
+// pipes and the standard input are read in large blocks.                 //
+//------------------------------------------------------------------------//
+
+bool data::read_file()
+{
+ int		fd;
+ struct stat	st;
+ bool		ok;
+ 
+ if(strlen(data_file_name())>0){
+  fd=open(data_file_name(),O_RDONLY);
+  if(fd<0){
+   cerr << "Error while opening " << data_file_name() << "!... Exiting..." << endl;
+   return false;
+  }
+  if((fstat(fd,&st)==0)&&S_ISREG(st.st_mode)&&(st.st_size>0)){
+   ok=read_mapped(fd,st.st_size);
+  }
+  else ok=read_stream(fd);
+  close(fd);
+ }
+ else ok=read_stream(0);		// Read data from standard input
+ return ok;
+}
+
+//------------------------------------------------------------------------//
+// This function reads a anova file. anova files should be in columnar    //
+// format, with the last column being the data values. The first line     //
+// have the names of the factors, each one with an optional '*' character //
+// in the end to be treated as a random factor. Comment lines starting    //
+// with an '#' are ignored. Several data files with the same factors are  //
+// read together, as if they were a single file.                          //
+//------------------------------------------------------------------------//
+
+bool data::read_data()
+{
+ bool ok;
+ 
+ lines=0;
+ in_header=true;
+ set_kernel();
+ if((window_rows()>0)||(window_seconds()>0)){
+  cerr << "A window can only be analysed while following a data file (--follow)!... Exiting..." << endl;
+  return false;
+ }
+ if(compare_transforms()&&!start_candidates()) return false;
+ if((response_columns()>0)&&!start_responses()) return false;
+ if((strlen(split_by())>0)&&!start_split()) return false;
+ if((mem_limit()>0)&&!start_spill()) return false;
+ if(merge_shards()) ok=read_shards();
+ else if((strlen(snapshot_file_name())>0)&&!rows) ok=read_snapshot();
+ else if(data_files()>1) ok=read_files();
+ else ok=read_file();
+ if(ringbuf) stop_pipeline();
+ if(ok&&spill) ok=gather_spill();
+ if(!ok) return false;
+ if(nt==0){
+  cerr << "No observations were read";
+  if(strlen(where_clause())>0) cerr << " (or none satisfies '" << where_clause() << "')";
+  cerr << "!... Exiting..." << endl;
+  return false;
+ }
+ sort_partials();
  return true; 
 }
 #else
@@ -1347,6 +2544,7 @@ bool data::read_data(char *buff)
    }
   }
  }while(!ins.eof());
+ sort_partials();
  return true; 
 }
 #endif
@@ -1361,7 +2559,7 @@ void data::summary()
  int fact,lev,i;
  
  #ifdef DEBUG_DATA
- partial *t;
+ int k;
  #endif
  
  if(be_verbose()){
@@ -1387,18 +2585,15 @@ void data::summary()
  }
  
  #ifdef DEBUG_DATA 
- if(first){
-  cout << "Table of partials..." << endl;
-  t=first;
-  do{
-   for(i=0;i<get_factors();i++) cout << (int) t->codes[i];
-   cout << " ";
-   for(i=0;i<get_factors();i++) cout << (int) t->orig[i];
-   cout << " Sum: " << t->sum << "\tSum2: " << t->sum2;
-   t->var=(t->sum2-(pow(t->sum,2)/t->n))/(t->n-1);
-   cout << "\tVar: " << t->var << "\t n: " << t->n << endl;
-   t=t->next;
-  }while(t);
+ if(grid){
+  cout << "Table of cells..." << endl;
+  for(k=0;k<grid->ncells;k++){
+   cout << k << " ";
+   for(i=0;i<get_factors();i++) cout << grid->orig[k*get_factors()+i];
+   cout << " Sum: " << grid->sum[k] << "\tSum2: " << grid->sum2[k];
+   cout << "\tVar: " << (grid->sum2[k]-(pow(grid->sum[k],2)/grid->n[k]))/(grid->n[k]-1);
+   cout << "\t n: " << grid->n[k] << endl;
+  }
  } 
  #endif
 }
@@ -30,25 +30,110 @@
 #ifndef DATA_H
 #define DATA_H 1
 
+#include <string_view>
 #include "conf.h"
 #include "base.h"
 
+using std::string_view;
+
 // Structure that will hold factor level combinations and respective sums, 
 // sums of squares and replicates. A list of these structures will be created
 // dynamically for all combinations read from the data file.
 
 struct partial{
- CODES  codes,orig;
+ LEVCODES codes,orig;
  double sum;
  double sum2;
  double var;
  int    n;
+ double *vec;	// Sums and sums of squares of all responses, with '--responses'
  partial  *next; 
  partial  *prev;
 };
 
+// Cells of the design once it is orthogonal, when there is one for each
+// combination of levels. Sums, sums of squares and replicates are stored
+// in arrays of their own, indexed by the level codes of each cell in mixed
+// radix (the code of the last factor varies fastest), so that sums of
+// squares are computed sweeping them in order. Original level codes are
+// kept aside, 'factors' per cell. If nested levels were recoded so that
+// two cells have the same codes, cells are kept in the order of the list
+// instead, with their codes in 'codes'. All arrays lie in one block, which
+// is mapped from a temporary file when cells are kept on disk.
+
+struct celltable{
+ int    ncells;
+ int    stride[MAXFACTORS];	// Cells between consecutive levels of each factor
+ double *sum;
+ double *sum2;
+ int    *n;
+ int    *orig;
+ int    *codes;		// Codes of each cell, only if cells are in a list
+ char   *block;		// Memory of all arrays...
+ size_t size;		// ...its size...
+ bool   mapped;		// ...and whether it is mapped from a file
+};
+
+// Structure that holds single observations (level codes and values) when
+// they must be kept, as when converting a data file to the binary format.
+
+struct rowset{
+ int    n,max;
+ LEVCODES *codes;
+ double *values;
+};
+
+// Dictionary of the names of the levels of a factor. Names are stored in
+// 'names' by level code and are found through the hash index 'slots',
+// which holds level codes plus one (0 is an empty slot).
+
+struct dictionary{
+ char **names;
+ int  nnames,maxnames;
+ int  *slots;
+ int  nslots;
+};
+
+// Filter on the values of one column, compiled from the predicates given
+// with '--where'. Values named in the predicates are kept in 'literals' and
+// 'accept' holds one bit per literal, set if rows with that value pass the
+// filter; 'other' tells if rows with any other value pass. Comparisons with
+// numbers restrict values to the range from 'min' to 'max'.
+
+struct filter{
+ int        col;
+ dictionary literals;
+ unsigned int *accept;
+ bool       other;
+ bool       ranged;
+ double     min,max;
+ bool       mininc,maxinc;
+};
+
+// Groups of rows analysed apart, with '--split-by'. Groups are named by the
+// values of column 'col', kept in 'names', and each one has its cells in a
+// 'data' of its own. 'group' is the group of the line being parsed.
+
+class data;
+
+struct splitter{
+ int        col;
+ dictionary names;
+ data       **groups;
+ int        maxgroups;
+ int        group;
+};
+
+struct ring;			// Defined in pipeline.cpp
+struct sharedcells;		// Defined in concurrent.cpp
+struct candidates;		// Defined in transforms.cpp
+struct window;			// Defined in follow.cpp
+struct responses;		// Defined in responses.cpp
+struct spiller;			// Defined in spill.cpp
+struct merger;			// Defined in shard.cpp
+
 struct combins{
- CODES codes;
+ LEVCODES codes;
  combins *next;
 };
 
@@ -68,7 +153,7 @@ class data: public base{
                                 //    modified if there are nested factors 
   FACTORNAMES factor_name;	// Names of each Factor     
   DATANAME data_name;		// Name of data valriable
-  CODENAMES code_name;		// Names of each Level in each Factor
+  dictionary code_name[MAXFACTORS];	// Names of each Level in each Factor
   FACTORTYPES factor_type;	// Type of factor: 0-Fixed, 1-Random                 
   int  nt;			// Total number of data points      
   int  n;			// Number of replicates  
@@ -78,14 +163,120 @@ class data: public base{
   
   partial *first,*last;	// Pointers to items of list of 'partial' terms 
   int     npartials;    // Number of partial terms
-  CODES   code_line;	// Temporary line to store level codes for each observation
+  partial **cells;      // Hash index of 'partial' terms keyed on 'orig'
+  int     ncells;       // Number of slots in 'cells' (a power of 2)
+  celltable *grid;      // Cells by level codes, once orthogonalized
+  LEVCODES code_line;	// Temporary line to store level codes for each observation
+  int     lines;        // Number of lines read from the data file
+  bool    in_header;    // True until the line with factor names is read
+  bool    quiet;        // Do not report errors (parsing or analysing in threads)
+  string_view *tokens;  // Tokens of the line being parsed
+  int     maxtokens;    // Size of 'tokens'
+  rowset  *rows;        // If not NULL, observations are stored here
+  int     factcol[MAXFACTORS]; // Columns of factors, with '--factors'
+  int     datacol;      // Column of data values, with '--factors' or '--response'
+  int     ncols;        // Number of columns to split in data lines
+  char    stats;        // Kind of data file: RAWDATA, SUMDATA or MEANDATA
+  int     statcol[3];   // Columns of replicates, sum or mean and sum of
+                        // squares or variance, in summary data files
+  sharedcells *shared;  // Tables shared by threads, with '--threads'
+  unsigned long long keybase; // Order of the first line of the data read...
+  unsigned long long linekey; // ...of the line being parsed...
+  unsigned long long chunkkey; // ...and of the chunk of lines being parsed
+  int     parse_until;  // If not 0, parsing stops once 'nt' reaches it
+  ring    *ringbuf;     // Observations passed between threads, with '--pipeline'
+  filter  *filters;     // Filters on rows, with '--where'
+  int     nfilters;     // Number of filters
+  void    (*kernel)(double *, int); // Transformations, with -p and -t
+  LEVCODES *batchcodes; // Observations waiting to be transformed
+  double  *batchvalues;
+  int     nbatch;
+  candidates *cands;    // Sums under all transformations, with '--transforms'
+  window  *win;         // Observations analysed, with '--window'
+  responses *resp;      // Names and values of responses, with '--responses'
+  splitter *split;      // Cells of groups of rows, with '--split-by'
+  spiller *spill;       // Cells kept on disk, with '--mem-limit'
+  merger  *merged;      // Exact sums of cells, with '--merge'
   
   // Private functions
   
-  char set_code(int, const char *);
+  int  set_code(int, string_view);
   void set_factor_type(int, char);
-  void add_code_line(CODES, double);
+  unsigned int hash_codes(LEVCODES);
+  int  compare_codes(LEVCODES, LEVCODES);
+  void grow_cells();
+  partial *get_partial(LEVCODES);
+  void add_row(LEVCODES, double);
+  void add_code_line(LEVCODES, double);
+  void add_observation(LEVCODES, double);
+  void sort_partials();
   void recode(int , int);
+  bool build_grid();
+  void free_grid();
+  #ifndef CGI
+  int  split_line(const char *, const char *, int);
+  static double token_value(string_view);
+  int  find_column(string_view, int);
+  bool find_stats(int);
+  bool project_columns(int);
+  bool add_summary(double, double, double, int);
+  filter *get_filter(int);
+  bool compile_where(int);
+  bool accept_line();
+  bool parse_line(const char *, const char *);
+  const char *parse_lines(const char *, const char *, bool);
+  const char *parse_buffer(const char *, const char *, bool);
+  bool read_binary(const char *, const char *);
+  bool read_arrow(const char *, const char *);
+  unsigned long long snapshot_key(const char *, size_t);
+  bool load_snapshot(const char *, const char *, bool);
+  bool write_snapshot(unsigned long long, const char *, size_t);
+  bool read_snapshot();
+  bool read_parallel(const char *, const char *, int);
+  int  shared_code(int, string_view);
+  void shared_add(LEVCODES, double, double, int);
+  void reserve_shared(int);
+  void release_shared(int);
+  bool parse_chunks(const char **, int);
+  void collect_shared(sharedcells *);
+  bool read_mapped(int, size_t);
+  bool read_stream(int);
+  bool read_file();
+  bool read_files();
+  bool check_header();
+  bool read_gzip(int, const char *, size_t);
+  void start_pipeline();
+  void pass_value(LEVCODES, double);
+  void summarize_batches();
+  void stop_pipeline();
+  void set_kernel();
+  void flush_batch();
+  bool start_candidates();
+  void add_candidates(LEVCODES, double);
+  void stop_candidates();
+  void start_window();
+  void add_window(LEVCODES, double);
+  long expire_window();
+  void stop_window();
+  bool start_responses();
+  bool name_responses(int);
+  void add_responses();
+  void equalize_responses(partial *, int);
+  void stop_responses();
+  bool start_split();
+  void add_split(LEVCODES, double);
+  void stop_split();
+  void copy_cells(data *, partial *);
+  bool start_spill();
+  void spill_cells();
+  bool make_room();
+  bool gather_spill();
+  void *map_spill(size_t);
+  void stop_spill();
+  bool load_shard(const char *, const char *, bool);
+  bool read_shards();
+  void stop_merge();
+  #endif
   void multi_comp(CODES , int, const char *, double, int, partial *);
   void compare(int , int , double , int , partial *, partial *);  
     
@@ -98,7 +289,7 @@ class data: public base{
   bool set_factor(const char *);
   void set_factor_name(int, const char *);
   void set_data_name(const char *);
-  bool add_code(int, const char *, int);
+  bool add_code(int, string_view, int);
   bool add_value(int, double, int);
   
   // Functions to get information about the data
@@ -133,6 +324,20 @@ class data: public base{
   double transform(double);
   #ifndef CGI
   bool   read_data();
+  bool   convert();
+  bool   write_shard();
+  void   report_candidates();
+  bool   follow(void (*)(data *));
+  void   take_cells(data *);
+  int    get_groups();
+  const char *get_group_name(int);
+  void   take_group(data *, int);
+  int    get_responses();
+  const char *get_response_name(int);
+  void   get_partial_SS(CODES, double *, int, int);
+  void   get_CT(double *, int, int);
+  void   get_sum_of_squares(double *, int, int);
+  void   get_error_ss(double *, int, int);
   #else
   bool   read_data(char *);
   #endif
@@ -0,0 +1,341 @@
+// follow.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file follows a growing data file, or the standard input, as 'tail -f'
+// does ('--follow'). Lines are added to the sums of cells as they arrive and
+// the analysis is run again every so many rows or seconds. Each analysis is
+// made on a copy of the cells, since the analysis modifies them (missing
+// replicates, nested factors), so it costs as much as the number of cells
+// and not as the number of rows read so far.
+//
+// With '--window' only the last rows, or those read in the last seconds,
+// are analysed. Observations are kept in a queue as they are added to their
+// cells and subtracted from them when they leave the window, so each one
+// costs the same whatever the size of the window.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include "data.h"
+
+using namespace std;
+
+#define FOLLOWWAIT 200		// Milliseconds to wait for a file to grow
+
+// An observation in the window: its cell, value and arrival time
+
+struct entry{
+ partial *cell;
+ double  value;
+ double  time;
+};
+
+// Queue of the observations in the window, oldest first ('head'). It is
+// a ring of 'max' entries, doubled when full.
+
+struct window{
+ entry   *e;
+ long    head,n,max;
+ chrono::steady_clock::time_point start;
+};
+
+//------------------------------------------------------------------------//
+// This function creates the window, with '--window'                      //
+//------------------------------------------------------------------------//
+
+void data::start_window()
+{
+ win = new window;
+ win->max=(window_rows()>0)?window_rows()+1:1024;
+ win->e = new entry[win->max];
+ win->head=0;
+ win->n=0;
+ win->start=chrono::steady_clock::now();
+}
+
+//------------------------------------------------------------------------//
+// This function removes the window                                       //
+//------------------------------------------------------------------------//
+
+void data::stop_window()
+{
+ delete [] win->e;
+ delete win;
+ win=NULL;
+}
+
+//------------------------------------------------------------------------//
+// This function subtracts the observations which left the window from    //
+// their cells: all but the last window_rows(), or those read more than   //
+// window_seconds() ago. Sums of cells left empty are cleared, so errors  //
+// of rounding do not pile up. It returns the observations removed.       //
+//------------------------------------------------------------------------//
+
+long data::expire_window()
+{
+ entry  *x;
+ double now;
+ long   removed;
+
+ now=chrono::duration<double>(chrono::steady_clock::now()-win->start).count();
+ removed=0;
+ while((win->n>0)&&(((window_rows()>0)&&(win->n>window_rows()))||
+       ((window_seconds()>0)&&(now-win->e[win->head].time>window_seconds())))){
+  x=&win->e[win->head];
+  x->cell->sum-=x->value;
+  x->cell->sum2-=pow(x->value,2);
+  x->cell->n--;
+  if(x->cell->n==0) x->cell->sum=x->cell->sum2=0;
+  win->head=(win->head+1)%win->max;
+  win->n--;
+  removed++;
+ }
+ return removed;
+}
+
+//------------------------------------------------------------------------//
+// This function adds an observation with level codes 'cline' and value   //
+// 'val' to its cell and to the window, removing those which leave it.    //
+//------------------------------------------------------------------------//
+
+void data::add_window(LEVCODES cline, double val)
+{
+ entry   *e;
+ partial *t;
+ long    i;
+
+ t=get_partial(cline);
+ t->sum+=val;
+ t->sum2+=pow(val,2);
+ t->n++;
+ if(win->n==win->max){
+  e = new entry[2*win->max];
+  for(i=0;i<win->n;i++) e[i]=win->e[(win->head+i)%win->max];
+  delete [] win->e;
+  win->e=e;
+  win->head=0;
+  win->max*=2;
+ }
+ e=&win->e[(win->head+win->n)%win->max];
+ e->cell=t;
+ e->value=val;
+ e->time=0;
+ if(window_seconds()>0) e->time=chrono::duration<double>(chrono::steady_clock::now()-win->start).count();
+ win->n++;
+ expire_window();
+}
+
+//------------------------------------------------------------------------//
+// This function copies factors and levels of 'from', and the sums of the //
+// list of 'cells' (with level codes of 'from'), into this (empty) data,  //
+// as they are before being analysed. Empty cells, as those left by the   //
+// window, are not copied, nor levels which are only found in them, so    //
+// they are not taken as missing combinations. Levels are coded in the    //
+// order they are first found in 'cells', which is the order they were    //
+// read (in a group of rows, the order they were read in the group).      //
+//------------------------------------------------------------------------//
+
+void data::copy_cells(data *from, partial *cells)
+{
+ partial  *t,*p;
+ int      *map[MAXFACTORS];
+ LEVCODES cline;
+ int      f,l;
+
+ for(f=0;f<from->get_factors();f++){
+  map[f] = new int[from->get_levels(f)];
+  for(l=0;l<from->get_levels(f);l++) map[f][l]=-1;
+ }
+ for(t=cells;t;t=t->next){
+  if(t->n>0) for(f=0;f<from->get_factors();f++) map[f][t->orig[f]]=-2;
+ }
+ for(f=0;f<from->get_factors();f++){
+  set_factor(from->factor_name[f]);
+  set_factor_type(f,from->factor_type[f]);
+ }
+ for(t=cells;t;t=t->next){
+  for(f=0;f<from->get_factors();f++){
+   l=t->orig[f];
+   if(map[f][l]==-2) map[f][l]=set_code(f,from->get_code_name(f,l));
+  }
+ }
+ set_data_name(from->data_name);
+ memset(cline,0,sizeof(cline));
+ for(t=cells;t;t=t->next){
+  if(t->n==0) continue;
+  for(f=0;f<from->get_factors();f++) cline[f]=map[f][t->orig[f]];
+  p=get_partial(cline);
+  p->sum=t->sum;
+  p->sum2=t->sum2;
+  p->n=t->n;
+  nt+=t->n;
+ }
+ sort_partials();
+ for(f=0;f<from->get_factors();f++) delete [] map[f];
+}
+
+//------------------------------------------------------------------------//
+// This function copies the data read so far by 'from' into this data     //
+//------------------------------------------------------------------------//
+
+void data::take_cells(data *from)
+{
+ copy_cells(from,from->first);
+}
+
+//------------------------------------------------------------------------//
+// This function reads the data file (or the standard input) as it grows, //
+// calling 'report' to analyse the data read so far after every           //
+// follow_rows() new observations, or after follow_seconds() if fewer     //
+// arrived. Parsing of a block stops every follow_rows() observations to  //
+// analyse them, however many lines the block has. At the end of a        //
+// regular file it waits for more lines; the standard input or a pipe is  //
+// read until it is closed. With a window of seconds the data is analysed //
+// again after follow_seconds() if observations left the window, even if  //
+// no new ones arrived.                                                   //
+//------------------------------------------------------------------------//
+
+bool data::follow(void (*report)(data *))
+{
+ char        *buff,*b;
+ const char  *rest,*s,*e;
+ size_t      size,used,len;
+ ssize_t     r;
+ struct stat st;
+ struct pollfd pfd;
+ int         fd,reported;
+ long        expired;
+ bool        ok,regular,waiting,closed;
+ chrono::steady_clock::time_point last;
+
+ if(pipeline()||(strlen(snapshot_file_name())>0)||(data_files()>1)||compare_transforms()||
+    (response_columns()>0)||(strlen(split_by())>0)||(mem_limit()>0)||merge_shards()){
+  cerr << "Only a single data file can be followed, with no other way of reading it!... Exiting..." << endl;
+  return false;
+ }
+ if((window_rows()>0)||(window_seconds()>0)) start_window();
+ if(strlen(data_file_name())>0){
+  fd=open(data_file_name(),O_RDONLY);
+  if(fd<0){
+   cerr << "Error while opening " << data_file_name() << "!... Exiting..." << endl;
+   return false;
+  }
+ }
+ else fd=0;
+ regular=(fstat(fd,&st)==0)&&S_ISREG(st.st_mode);
+ lines=0;
+ in_header=true;
+ set_kernel();
+
+ size=BLOCKSIZE;
+ used=0;
+ buff = new char[size];
+ reported=0;
+ expired=0;
+ last=chrono::steady_clock::now();
+ ok=true;
+ for(;;){
+  if(used==size){
+   b = new char[2*size];
+   memcpy(b,buff,used);
+   delete [] buff;
+   buff=b;
+   size*=2;
+  }
+
+  // Pipes are waited for only so long, so a window of seconds can expire
+  // while no lines arrive
+
+  waiting=false;
+  if(!regular){
+   pfd.fd=fd;
+   pfd.events=POLLIN;
+   pfd.revents=0;
+   waiting=(poll(&pfd,1,FOLLOWWAIT)==0);
+  }
+  r=waiting?0:read(fd,buff+used,size-used);
+  closed=(r==0)&&!regular&&!waiting;
+  if(r<0){
+   if(errno==EINTR) continue;
+   cerr << "Error while reading " << data_file_name() << "!... Exiting..." << endl;
+   ok=false;
+   break;
+  }
+  if((lines==0)&&(used==0)&&(r>=2)&&((unsigned char) buff[0]==0x1f)&&((unsigned char) buff[1]==0x8b)){
+   cerr << "Compressed data files cannot be followed!... Exiting..." << endl;
+   ok=false;
+   break;
+  }
+
+  // Parse complete lines; the last one of a closed pipe needs no newline.
+  // The data is analysed each time follow_rows() new observations arrive.
+
+  s=buff;
+  e=buff+used+r;
+  for(;;){
+   parse_until=reported+follow_rows();
+   rest=parse_buffer(s,e,closed);
+   if(!rest||(nt<parse_until)) break;
+   if(win) expire_window();
+   report(this);
+   reported=nt;
+   expired=0;
+   last=chrono::steady_clock::now();
+   s=rest;
+  }
+  parse_until=0;
+  if(!rest){
+   ok=false;
+   break;
+  }
+  len=buff+used+r-rest;
+  memmove(buff,rest,len);
+  used=len;
+
+  // Analyse the data if enough rows, or time, have gone by
+
+  if(win) expired+=expire_window();
+  if(((nt>reported)||(expired>0))&&((nt-reported>=follow_rows())||closed||
+     (chrono::steady_clock::now()-last>=chrono::seconds(follow_seconds())))){
+   report(this);
+   reported=nt;
+   expired=0;
+   last=chrono::steady_clock::now();
+  }
+  if(closed) break;
+  if((r==0)&&regular) this_thread::sleep_for(chrono::milliseconds(FOLLOWWAIT));
+ }
+ delete [] buff;
+ if(fd!=0) close(fd);
+ if(win) stop_window();
+ return ok;
+}
+
+#endif
@@ -0,0 +1,280 @@
+// gzip.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file reads gzip compressed data files (or standard input) without
+// decompressing them to disk. A separate thread inflates the data into a
+// small pool of blocks while the main thread parses the blocks already
+// inflated, so decompression overlaps with parsing. It needs zlib, and
+// without it compressed data files are only recognized and rejected.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+#include "../config.h"
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#endif
+#include "data.h"
+
+using namespace std;
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+
+// Blocks of inflated data passed from the decompressing thread to the
+// parser. Blocks are used in turn: the thread fills block 'filled' while
+// 'ready' blocks wait to be parsed, and stops when all blocks are ready.
+
+struct gzqueue{
+ char    *block[GZBLOCKS];
+ size_t  len[GZBLOCKS];
+ int     filled,parsed,ready;
+ bool    done,failed,stop;
+ size_t  in,out;		// Bytes read and inflated
+ double  seconds;		// Time spent inflating
+ mutex   lock;
+ condition_variable changed;
+};
+
+//------------------------------------------------------------------------//
+// This function inflates the gzip data in 'head' (the first 'nhead'      //
+// bytes, already read or mapped) followed by whatever can still be read  //
+// from 'fd' (-1 if there is nothing else) into the blocks of 'q'. It     //
+// runs in its own thread. Concatenated gzip members are all inflated.    //
+//------------------------------------------------------------------------//
+
+static void inflate_blocks(gzqueue *q, int fd, const char *head, size_t nhead)
+{
+ z_stream  z;
+ char      *in;
+ ssize_t   r;
+ int       status,b;
+ bool      eof,ended;
+ chrono::steady_clock::time_point t0;
+
+ memset(&z,0,sizeof(z));
+ in=NULL;
+ if(inflateInit2(&z,15+32)!=Z_OK){	// 15+32: gzip or zlib headers
+  lock_guard<mutex> g(q->lock);
+  q->failed=true;
+  q->done=true;
+  q->changed.notify_all();
+  return;
+ }
+ z.next_in=(Bytef *) head;
+ z.avail_in=nhead;
+ q->in=nhead;
+ eof=(fd<0);
+ ended=false;
+ if(!eof) in = new char[BLOCKSIZE];
+ status=Z_OK;
+ for(;;){
+
+  // Wait for a free block
+
+  {
+   unique_lock<mutex> g(q->lock);
+   q->changed.wait(g,[q]{ return (q->ready<GZBLOCKS)||q->stop; });
+   if(q->stop) break;
+   b=q->filled;
+  }
+
+  // Fill it. Input ending before the end of a gzip member (a truncated
+  // file) leaves 'status' with an error
+
+  t0=chrono::steady_clock::now();
+  z.next_out=(Bytef *) q->block[b];
+  z.avail_out=BLOCKSIZE;
+  while(z.avail_out>0){
+   if((z.avail_in==0)&&!eof){
+    r=read(fd,in,BLOCKSIZE);
+    if((r<0)&&(errno==EINTR)) continue;
+    if(r<=0){
+     eof=true;
+     if(r<0){
+      status=Z_ERRNO;
+      break;
+     }
+    }
+    else{
+     z.next_in=(Bytef *) in;
+     z.avail_in=r;
+     q->in+=r;
+    }
+   }
+   if(ended){
+    if(z.avail_in==0){
+     if(eof) break;
+     continue;
+    }
+    inflateReset(&z);			// Another gzip member follows
+    ended=false;
+   }
+   status=inflate(&z,Z_NO_FLUSH);
+   if(status==Z_STREAM_END){
+    ended=true;
+    status=Z_OK;
+   }
+   else if(status!=Z_OK) break;
+  }
+  q->seconds+=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+
+  // Pass it to the parser
+
+  {
+   lock_guard<mutex> g(q->lock);
+   q->len[b]=BLOCKSIZE-z.avail_out;
+   q->out+=q->len[b];
+   q->filled=(b+1)%GZBLOCKS;
+   q->ready++;
+   q->failed=(status!=Z_OK);
+   q->done=q->failed||(ended&&eof&&(z.avail_in==0));
+   q->changed.notify_all();
+   if(q->done) break;
+  }
+ }
+ inflateEnd(&z);
+ if(in) delete [] in;
+}
+
+//------------------------------------------------------------------------//
+// This function reads gzip compressed data: the first 'nhead' bytes at   //
+// 'head' and the rest, if 'fd' is not -1, from 'fd'. Blocks inflated by  //
+// another thread are parsed as they arrive, keeping incomplete lines for //
+// the next block as read_stream does. In verbose mode it reports the     //
+// throughput of decompression and of parsing.                            //
+//------------------------------------------------------------------------//
+
+bool data::read_gzip(int fd, const char *head, size_t nhead)
+{
+ gzqueue    *q;
+ thread     th;
+ char       *buff,*b;
+ const char *rest;
+ size_t     size,used,len;
+ double     parsing;
+ bool       ok,last;
+ int        i;
+ chrono::steady_clock::time_point t0;
+
+ q = new gzqueue;
+ for(i=0;i<GZBLOCKS;i++){
+  q->block[i] = new char[BLOCKSIZE];
+  q->len[i]=0;
+ }
+ q->filled=q->parsed=q->ready=0;
+ q->done=q->failed=q->stop=false;
+ q->in=q->out=0;
+ q->seconds=0;
+ th=thread(inflate_blocks,q,fd,head,nhead);
+
+ size=2*BLOCKSIZE;
+ used=0;
+ buff = new char[size];
+ parsing=0;
+ ok=true;
+ for(;;){
+
+  // Wait for an inflated block and append it to what is left to parse
+
+  {
+   unique_lock<mutex> g(q->lock);
+   q->changed.wait(g,[q]{ return (q->ready>0)||q->done; });
+   if(q->ready==0) break;
+   last=q->done&&(q->ready==1);
+  }
+  len=q->len[q->parsed];
+  if(used+len>size){
+   while(used+len>size) size*=2;
+   b = new char[size];
+   memcpy(b,buff,used);
+   delete [] buff;
+   buff=b;
+  }
+  memcpy(buff+used,q->block[q->parsed],len);
+  used+=len;
+  {
+   lock_guard<mutex> g(q->lock);
+   q->parsed=(q->parsed+1)%GZBLOCKS;
+   q->ready--;
+   q->changed.notify_all();
+  }
+
+  // Parse all complete lines
+
+  t0=chrono::steady_clock::now();
+  rest=parse_buffer(buff,buff+used,last&&!q->failed);
+  parsing+=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  if(!rest){
+   ok=false;
+   break;
+  }
+  len=buff+used-rest;
+  memmove(buff,rest,len);
+  used=len;
+  if(last) break;
+ }
+
+ // Stop the thread if parsing failed
+
+ {
+  lock_guard<mutex> g(q->lock);
+  q->stop=true;
+  q->changed.notify_all();
+ }
+ th.join();
+ if(ok&&q->failed){
+  cerr << "Error while decompressing " << data_file_name() << "!... Exiting..." << endl;
+  ok=false;
+ }
+ if(ok&&be_verbose()){
+  cout << "Decompressed " << q->in << " into " << q->out << " bytes in ";
+  cout << q->seconds << " s (" << (q->seconds>0?q->out/q->seconds/1048576:0) << " MB/s)" << endl;
+  cout << "Parsed " << q->out << " bytes in " << parsing << " s (";
+  cout << (parsing>0?q->out/parsing/1048576:0) << " MB/s)" << endl;
+ }
+ for(i=0;i<GZBLOCKS;i++) delete [] q->block[i];
+ delete q;
+ delete [] buff;
+ return ok;
+}
+
+#else
+
+//------------------------------------------------------------------------//
+// Without zlib compressed data files cannot be read                      //
+//------------------------------------------------------------------------//
+
+bool data::read_gzip(int, const char *, size_t)
+{
+ cerr << "Compressed data files are not supported (mwanova was built without zlib)!... Exiting..." << endl;
+ return false;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+// kernels.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file applies the pre-transformation and the transformation of data
+// values (-p and -t) to batches of values. Each pair of transformations is
+// compiled into its own kernel, which is chosen once before reading data,
+// so no options are tested for each value. Square roots, products and
+// quotients are computed four (AVX) or two (SSE2) values at a time if the
+// compiler targets these instructions. Logarithms and arcsines are left to
+// the C library, value by value, so kernels give exactly the values of
+// data::transform.
+
+#ifndef CGI
+
+#include <cmath>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "data.h"
+
+#if defined(__AVX__)
+typedef __m256d VALUES;
+#define LANES         4
+#define LOAD(p)       _mm256_loadu_pd(p)
+#define STORE(p,v)    _mm256_storeu_pd(p,v)
+#define SQRT(v)       _mm256_sqrt_pd(v)
+#define MUL(v,x)      _mm256_mul_pd(v,_mm256_set1_pd(x))
+#define DIV(v,x)      _mm256_div_pd(v,_mm256_set1_pd(x))
+#elif defined(__SSE2__)
+typedef __m128d VALUES;
+#define LANES         2
+#define LOAD(p)       _mm_loadu_pd(p)
+#define STORE(p,v)    _mm_storeu_pd(p,v)
+#define SQRT(v)       _mm_sqrt_pd(v)
+#define MUL(v,x)      _mm_mul_pd(v,_mm_set1_pd(x))
+#define DIV(v,x)      _mm_div_pd(v,_mm_set1_pd(x))
+#endif
+
+//------------------------------------------------------------------------//
+// Transformation 'T' of a single value, as in data::transform            //
+//------------------------------------------------------------------------//
+
+template<int T> static inline double apply(double v)
+{
+ switch(T){
+  case SQRTRANSF: return sqrt(v);
+  case LNTRANSF:  return log(v+1);
+  case LOGTRANSF: return log10(v+1);
+  case ARCSTRANSF:  return asin(sqrt(v))*90/(M_PI/2);
+  case ARCSTRANSFRAD:  return asin(sqrt(v));
+  case MULT100: return v*100;
+  case DIV100: return v/100;
+ }
+ return v;
+}
+
+#ifdef LANES
+
+//------------------------------------------------------------------------//
+// Transformation 'T' of LANES values, if it has SIMD instructions        //
+//------------------------------------------------------------------------//
+
+template<int T> static inline bool vectorized()
+{
+ return (T==NOTRANSF)||(T==SQRTRANSF)||(T==MULT100)||(T==DIV100);
+}
+
+template<int T> static inline VALUES apply(VALUES v)
+{
+ switch(T){
+  case SQRTRANSF: return SQRT(v);
+  case MULT100: return MUL(v,100);
+  case DIV100: return DIV(v,100);
+ }
+ return v;
+}
+
+#endif
+
+//------------------------------------------------------------------------//
+// This function applies the pre-transformation 'P' and then the          //
+// transformation 'T' to the 'n' values at 'v', in place.                 //
+//------------------------------------------------------------------------//
+
+template<int P, int T> static void fused(double *v, int n)
+{
+ int i=0;
+
+ #ifdef LANES
+ if(vectorized<P>()&&vectorized<T>()){
+  for(;i+LANES<=n;i+=LANES) STORE(v+i,apply<T>(apply<P>(LOAD(v+i))));
+ }
+ #endif
+ for(;i<n;i++) v[i]=apply<T>(apply<P>(v[i]));
+}
+
+// Kernels for all pairs of transformations (NOTRANSF to DIV100)
+
+#define PRETRANSF(p) {fused<p,0>,fused<p,1>,fused<p,2>,fused<p,3>,\
+                      fused<p,4>,fused<p,5>,fused<p,6>,fused<p,7>}
+
+static void (* const kernels[8][8])(double *, int)={
+ PRETRANSF(0),PRETRANSF(1),PRETRANSF(2),PRETRANSF(3),
+ PRETRANSF(4),PRETRANSF(5),PRETRANSF(6),PRETRANSF(7)
+};
+
+//------------------------------------------------------------------------//
+// This function chooses the kernel for the transformations given with    //
+// -p and -t, or none if data values are not transformed at all.          //
+//------------------------------------------------------------------------//
+
+void data::set_kernel()
+{
+ if((pretransform()==NOTRANSF)&&(transformation()==NOTRANSF)) kernel=NULL;
+ else kernel=kernels[pretransform()][transformation()];
+}
+
+//------------------------------------------------------------------------//
+// This function transforms the values waiting in the batch and adds the  //
+// observations, in the order they were read.                             //
+//------------------------------------------------------------------------//
+
+void data::flush_batch()
+{
+ int i;
+
+ if(nbatch==0) return;
+ kernel(batchvalues,nbatch);
+ for(i=0;i<nbatch;i++) add_observation(batchcodes[i],batchvalues[i]);
+ nbatch=0;
+}
+
+#endif
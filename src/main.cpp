@@ -41,7 +41,14 @@ int main(int argc, char *argv[])
  if(d){
   if(argc>1){ 
    d->parse_args(argc,argv);
-   if(d->read_data()) d->run();
+   if(strlen(d->convert_file_name())>0) d->convert();
+   else if(strlen(d->batch_file_name())>0) d->batch();
+   else if(d->following()) d->follow();
+   else if(d->read_data()){
+    if(strlen(d->shard_file_name())>0) d->write_shard();
+    else if(d->compare_transforms()) d->report_candidates();
+    else d->run();
+   }
    
   }else d->help();
   delete d; 
@@ -965,17 +965,91 @@ void model::write_anova()
  #endif
 }
 
-void model:: run()
-{ 
+//------------------------------------------------------------------------//
+// This function fits the model to the data, computing the sums of        //
+// squares and dfs of all terms, without writing anything. It returns     //
+// false if there are missing combinations of factor levels.              //
+//------------------------------------------------------------------------//
+
+bool model::fit()
+{
  equalize();
  compute_nesting();
- if(orthogonalize()){
-  summary();
-  test_homogeneity();
-  build_orthogonal_model();
-  build_model(); 
-  ctrules();
-  write_anova();
-  averages();
- } 
+ if(!orthogonalize()) return false;
+ build_orthogonal_model();
+ build_model(); 
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function chooses the F tests and writes the results of the model  //
+// once it has been fitted.                                               //
+//------------------------------------------------------------------------//
+
+void model::report()
+{
+ summary();
+ #ifndef CGI
+ if(get_responses()==0)		// Homogeneity of the first response only
+ #endif
+ test_homogeneity();
+ ctrules();
+ #ifndef CGI
+ if(get_responses()>0){		// Many responses, in the same model
+  write_responses();
+  return;
+ }
+ #endif
+ write_anova();
+ averages();
+}
+
+void model:: run()
+{ 
+ #ifndef CGI
+ if(get_groups()>0){			// A model for each group of rows
+  run_groups();
+  return;
+ }
+ #endif
+ if(fit()) report();
+}
+
+#ifndef CGI
+//------------------------------------------------------------------------//
+// This function analyses the data read so far by 'd' while following a   //
+// data file, in a new model built from a copy of the cells of 'd'.       //
+//------------------------------------------------------------------------//
+
+static void refresh(class data *d)
+{
+ model      *m;
+ char       h[64];
+ ios::fmtflags flags;
+ streamsize prec;
+
+ flags=cout.flags();			// Each analysis formats output anew
+ prec=cout.precision();
+ m = new model;
+ *(base *) m=*(base *) d;
+ m->take_cells(d);
+ if(m->get_nt()<d->get_nt()) snprintf(h,sizeof(h)," %d observations (of %d read) ",m->get_nt(),d->get_nt());
+ else snprintf(h,sizeof(h)," %d observations ",d->get_nt());
+ m->header(h);
+ if(m->get_nt()>0) m->run();		// Not if all left the window
+ delete m;
+ cout.flags(flags);
+ cout.precision(prec);
+ cout << flush;
+}
+
+//------------------------------------------------------------------------//
+// This function follows a growing data file ('--follow'), running the    //
+// analysis again as new rows arrive.                                     //
+//------------------------------------------------------------------------//
+
+void model::follow()
+{
+ data::follow(refresh);
 }
+#endif
@@ -40,6 +40,8 @@ struct term{
  term   *prev;
 };
 
+struct job;
+
 class model: public data{
  private:
   CODES  fcode;
@@ -61,6 +63,13 @@ class model: public data{
   const char *set_term_name(CODES, char *);  
   
   void   averages();
+  bool   fit();
+  void   report();
+  #ifndef CGI
+  void   write_responses();
+  void   run_groups();
+  void   read_job(job *);
+  #endif
   
  public:
   model();
@@ -68,6 +77,10 @@ class model: public data{
   
   void write_anova();
   void run();  
+  #ifndef CGI
+  void follow();
+  void batch();
+  #endif
 };
 
 #endif /* !MODEL_H */
\ No newline at end of file
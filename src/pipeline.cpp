@@ -0,0 +1,181 @@
+// pipeline.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file splits the reading of data in two threads ('--pipeline'). The
+// thread reading the data file splits lines, sets level codes and
+// transforms values, and passes observations in batches through a ring
+// buffer to another thread, which adds them to the list of partials. The
+// ring has a fixed number of batches, so the reader waits when the
+// other thread falls behind and memory use stays bounded. The ring has a
+// single producer and a single consumer and needs no locks: each side
+// only writes its own index.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "data.h"
+
+using namespace std;
+
+// An observation: level codes and (transformed) data value
+
+struct record{
+ LEVCODES codes;
+ double   value;
+};
+
+// Ring of RINGSIZE batches of RINGBATCH observations. The reader fills
+// batch 'head' and the other thread empties batch 'tail' (both modulo
+// RINGSIZE); the ring is full when 'head' is RINGSIZE batches ahead.
+
+struct ring{
+ record        *batch[RINGSIZE];
+ int           len[RINGSIZE];
+ atomic<long>  head,tail;
+ atomic<bool>  done;
+ int           used;		// Observations in batch 'head'
+ long          batches;		// Batches passed through the ring
+ double        readwait;	// Seconds the reader waited for a free batch
+ double        sumwait;		// Seconds the other thread waited for data
+ thread        th;
+};
+
+//------------------------------------------------------------------------//
+// This function runs in its own thread and adds the observations of the  //
+// batches in the ring to the list of partials, until the reader is done. //
+//------------------------------------------------------------------------//
+
+void data::summarize_batches()
+{
+ long   t;
+ int    i,b;
+ chrono::steady_clock::time_point t0;
+
+ for(;;){
+  t=ringbuf->tail.load(memory_order_relaxed);
+  if(ringbuf->head.load(memory_order_acquire)==t){
+   t0=chrono::steady_clock::now();
+   while(ringbuf->head.load(memory_order_acquire)==t){
+    if(ringbuf->done.load(memory_order_acquire)&&(ringbuf->head.load(memory_order_acquire)==t)){
+     ringbuf->sumwait+=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+     return;
+    }
+    this_thread::yield();
+   }
+   ringbuf->sumwait+=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  }
+  b=t%RINGSIZE;
+  for(i=0;i<ringbuf->len[b];i++){
+   add_code_line(ringbuf->batch[b][i].codes,ringbuf->batch[b][i].value);
+  }
+  ringbuf->tail.store(t+1,memory_order_release);
+ }
+}
+
+//------------------------------------------------------------------------//
+// This function creates the ring and starts the thread which adds the    //
+// observations to the list of partials.                                  //
+//------------------------------------------------------------------------//
+
+void data::start_pipeline()
+{
+ int i;
+
+ ringbuf = new ring;
+ for(i=0;i<RINGSIZE;i++){
+  ringbuf->batch[i] = new record[RINGBATCH];
+  ringbuf->len[i]=0;
+ }
+ ringbuf->head=0;
+ ringbuf->tail=0;
+ ringbuf->done=false;
+ ringbuf->used=0;
+ ringbuf->batches=0;
+ ringbuf->readwait=0;
+ ringbuf->sumwait=0;
+ ringbuf->th=thread(&data::summarize_batches,this);
+}
+
+//------------------------------------------------------------------------//
+// This function passes the observation with level codes 'cline' and      //
+// value 'val' to the other thread. A batch is handed over when it is     //
+// full; a new batch is only started when the ring has room for it.      //
+//------------------------------------------------------------------------//
+
+void data::pass_value(LEVCODES cline, double val)
+{
+ long   h;
+ record *r;
+ chrono::steady_clock::time_point t0;
+
+ h=ringbuf->head.load(memory_order_relaxed);
+ if((ringbuf->used==0)&&(h-ringbuf->tail.load(memory_order_acquire)==RINGSIZE)){
+  t0=chrono::steady_clock::now();
+  while(h-ringbuf->tail.load(memory_order_acquire)==RINGSIZE) this_thread::yield();
+  ringbuf->readwait+=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+ }
+ r=&ringbuf->batch[h%RINGSIZE][ringbuf->used++];
+ memcpy(r->codes,cline,sizeof(LEVCODES));
+ r->value=val;
+ if(ringbuf->used==RINGBATCH){
+  ringbuf->len[h%RINGSIZE]=RINGBATCH;
+  ringbuf->head.store(h+1,memory_order_release);
+  ringbuf->used=0;
+  ringbuf->batches++;
+ }
+}
+
+//------------------------------------------------------------------------//
+// This function hands over the last batch, waits for the other thread to //
+// add all observations to the list of partials and removes the ring. In  //
+// verbose mode it reports how long each thread waited for the other.     //
+//------------------------------------------------------------------------//
+
+void data::stop_pipeline()
+{
+ long h;
+ int  i;
+
+ h=ringbuf->head.load(memory_order_relaxed);
+ if(ringbuf->used>0){
+  ringbuf->len[h%RINGSIZE]=ringbuf->used;
+  ringbuf->head.store(h+1,memory_order_release);
+  ringbuf->used=0;
+  ringbuf->batches++;
+ }
+ ringbuf->done.store(true,memory_order_release);
+ ringbuf->th.join();
+ if(be_verbose()){
+  cout << "Pipeline: " << ringbuf->batches << " batches of up to " << RINGBATCH;
+  cout << " observations" << endl;
+  cout << "\treader waited " << ringbuf->readwait << " s for free batches" << endl;
+  cout << "\tsummarizing waited " << ringbuf->sumwait << " s for data" << endl;
+ }
+ for(i=0;i<RINGSIZE;i++) delete [] ringbuf->batch[i];
+ delete ringbuf;
+ ringbuf=NULL;
+}
+
+#endif
@@ -27,9 +27,17 @@
 // of the code that computes Cochran's C probabilities.
 
 #include <cmath>
+#ifndef CGI
+#include <map>
+#include <mutex>
+#include <tuple>
+#endif
 #include "conf.h"
 using namespace std;
 
+#define QMAX    1024		// Largest critical value of Q searched
+#define QSTEPS  48		// Bisections of critical values of Q
+
 //------------------------------------------------------------------------//
 // Algorithm AS66 Applied Statistics (1973) vol22 no.3                    //
 // Evaluates the tail area of the standardised normal curve               //
@@ -302,6 +310,41 @@ double qprob(double q, int k, int df)
  return 1-prtrng(q,df,k);
 }
 
+#ifndef CGI
+//------------------------------------------------------------------------//
+// This function returns the critical value of Q for k means, df degrees  //
+// of freedom and significance 'alpha': the smallest q for which          //
+// qprob(q,k,df) is not above alpha, found by bisection. Critical values  //
+// are kept, for all the analyses of a batch and their threads, so each   //
+// is computed once instead of a probability for every pair of means.     //
+//------------------------------------------------------------------------//
+
+double qcritical(int k, int df, double alpha)
+{
+ static map<tuple<int,int,double>,double> found;
+ static mutex lock;
+ double lo,hi,mid;
+ int    i;
+
+ lock_guard<mutex> guard(lock);
+ auto c=found.find(make_tuple(k,df,alpha));
+ if(c!=found.end()) return c->second;
+ lo=0;
+ hi=1;
+ while((qprob(hi,k,df)>alpha)&&(hi<QMAX)){
+  lo=hi;
+  hi*=2;
+ }
+ for(i=0;i<QSTEPS;i++){
+  mid=(lo+hi)/2;
+  if(qprob(mid,k,df)>alpha) lo=mid;
+  else hi=mid;
+ }
+ found[make_tuple(k,df,alpha)]=hi;
+ return hi;
+}
+#endif
+
 //------------------------------------------------------------------------//
 // This function computes Cochran's C exact probability for k means and   //
 // df degrees of freedom.                                                 //
@@ -23,6 +23,9 @@
 #define PROBS_H 1
 
 double qprob(double , int, int);
+#ifndef CGI
+double qcritical(int, int, double);
+#endif
 double cprob(double , int , int);
 double fprob(double , int , int);
 double chiprob(double , int);
@@ -0,0 +1,484 @@
+// responses.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file analyses many responses measured in the same design in a single
+// reading of the data file ('--responses'). The last columns of the data
+// file are all responses, and each combination of factor levels keeps the
+// sums and sums of squares of all of them in one vector ('partial::vec').
+// The model (nesting, terms, Cornfield-Tukey rules and F tests) is built
+// once, from the first response, and the sums of squares of all terms are
+// then computed for blocks of responses at a time, adding and squaring
+// vectors of responses with AVX or SSE2 instructions if the compiler targets
+// them. Each term is a sum of partial sums of squares with signs (see
+// model::get_SS), which are computed once for each combination of factors.
+// P values may be adjusted across responses for the false discovery rate
+// (Benjamini-Hochberg, '--fdr').
+
+#ifndef CGI
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "model.h"
+#include "probs.h"
+
+using namespace std;
+
+// Responses read from the last columns of the data file
+
+struct responses{
+ int    n;			// Number of responses
+ char   **names;		// Their names
+ double *values;		// Their values in the line being parsed
+};
+
+//------------------------------------------------------------------------//
+// These functions add the 'n' values at 'b' (or their squares) to those  //
+// at 'a', four (AVX) or two (SSE2) at a time if possible.                //
+//------------------------------------------------------------------------//
+
+static inline void add_values(double *a, const double *b, int n)
+{
+ int i=0;
+
+ #if defined(__AVX__)
+ for(;i+4<=n;i+=4){
+  _mm256_storeu_pd(a+i,_mm256_add_pd(_mm256_loadu_pd(a+i),_mm256_loadu_pd(b+i)));
+ }
+ #elif defined(__SSE2__)
+ for(;i+2<=n;i+=2){
+  _mm_storeu_pd(a+i,_mm_add_pd(_mm_loadu_pd(a+i),_mm_loadu_pd(b+i)));
+ }
+ #endif
+ for(;i<n;i++) a[i]+=b[i];
+}
+
+static inline void add_squares(double *a, const double *b, int n)
+{
+ int i=0;
+
+ #if defined(__AVX__)
+ __m256d v;
+ for(;i+4<=n;i+=4){
+  v=_mm256_loadu_pd(b+i);
+  _mm256_storeu_pd(a+i,_mm256_add_pd(_mm256_loadu_pd(a+i),_mm256_mul_pd(v,v)));
+ }
+ #elif defined(__SSE2__)
+ __m128d v;
+ for(;i+2<=n;i+=2){
+  v=_mm_loadu_pd(b+i);
+  _mm_storeu_pd(a+i,_mm_add_pd(_mm_loadu_pd(a+i),_mm_mul_pd(v,v)));
+ }
+ #endif
+ for(;i<n;i++) a[i]+=b[i]*b[i];
+}
+
+//------------------------------------------------------------------------//
+// This function starts reading many responses, with '--responses'. It    //
+// returns false if they cannot be read this way.                         //
+//------------------------------------------------------------------------//
+
+bool data::start_responses()
+{
+ if(strlen(response_name())>0){
+  cerr << "A response cannot be selected with --responses!... Exiting..." << endl;
+  return false;
+ }
+ if(rows||pipeline()||(strlen(snapshot_file_name())>0)||(data_files()>1)||compare_transforms()){
+  cerr << "Many responses can only be read from a single data file, with no other way of reading it!... Exiting..." << endl;
+  return false;
+ }
+ resp = new responses;
+ resp->n=response_columns();
+ resp->names = new char*[resp->n];
+ memset(resp->names,0,resp->n*sizeof(char *));
+ resp->values = new double[resp->n];
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function takes the names of the responses, the last columns       //
+// among the 'ntokens' names of the header line, and sets 'datacol' to    //
+// the first of them.                                                     //
+//------------------------------------------------------------------------//
+
+bool data::name_responses(int ntokens)
+{
+ int r,len;
+
+ if(resp->n>=ntokens){
+  cerr << "There are not enough columns for " << resp->n << " responses and a factor!... Exiting..." << endl;
+  return false;
+ }
+ datacol=ntokens-resp->n;
+ for(r=0;r<resp->n;r++){
+  len=tokens[datacol+r].size();
+  resp->names[r] = new char[len+1];
+  memcpy(resp->names[r],tokens[datacol+r].data(),len);
+  resp->names[r][len]=0;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function adds the responses of the line just split, transformed   //
+// with -p and -t, to the vector of sums of the combination of factor     //
+// levels in 'code_line'. The first response is also added to the sums of //
+// the combination, from which the model is built.                        //
+//------------------------------------------------------------------------//
+
+void data::add_responses()
+{
+ partial *t;
+ double  *v;
+ int     r;
+
+ v=resp->values;
+ for(r=0;r<resp->n;r++) v[r]=token_value(tokens[datacol+r]);
+ if(kernel) kernel(v,resp->n);
+ t=get_partial(code_line);
+ if(!t->vec){
+  t->vec = new double[2*resp->n];
+  memset(t->vec,0,2*resp->n*sizeof(double));
+ }
+ t->sum+=v[0];
+ t->sum2+=pow(v[0],2);
+ t->n++;
+ add_values(t->vec,v,resp->n);
+ add_squares(t->vec+resp->n,v,resp->n);
+ memset(code_line,0,sizeof(code_line));
+ nt++;
+}
+
+//------------------------------------------------------------------------//
+// This function adds 'newreps' missing replicates, equal to the average  //
+// of each response, to the vector of sums of 't', as data::equalize does //
+// for the first response.                                                //
+//------------------------------------------------------------------------//
+
+void data::equalize_responses(partial *t, int newreps)
+{
+ double average;
+ int    r,i;
+
+ for(r=0;r<resp->n;r++){
+  average=t->vec[r]/t->n;
+  for(i=0;i<newreps;i++){
+   t->vec[r]+=average;
+   t->vec[resp->n+r]+=pow(average,2);
+  }
+ }
+}
+
+//------------------------------------------------------------------------//
+// This function removes the names and values of responses                //
+//------------------------------------------------------------------------//
+
+void data::stop_responses()
+{
+ int r;
+
+ for(r=0;r<resp->n;r++) if(resp->names[r]) delete [] resp->names[r];
+ delete [] resp->names;
+ delete [] resp->values;
+ delete resp;
+ resp=NULL;
+}
+
+//------------------------------------------------------------------------//
+// These functions return the number of responses (0 if there is a single //
+// one, read the usual way) and the name of response 'r'.                 //
+//------------------------------------------------------------------------//
+
+int data::get_responses()
+{
+ return resp?resp->n:0;
+}
+
+const char *data::get_response_name(int r)
+{
+ return resp->names[r];
+}
+
+//------------------------------------------------------------------------//
+// This function returns in 'ss' the partial sums of squares of the 'nr'  //
+// responses from 'r0' on, for the factors with a 1 in 'cline', as        //
+// data::get_partial_SS does for a single response. Since all             //
+// combinations of (orthogonalized) levels are present, the combinations  //
+// of levels of these factors are numbered from their level codes, and    //
+// their sums kept in a table of 'nr' responses per combination.          //
+//------------------------------------------------------------------------//
+
+void data::get_partial_SS(CODES cline, double *ss, int r0, int nr)
+{
+ partial *t;
+ double  *sums;
+ int     ncombins,c,i;
+
+ ncombins=1;
+ for(i=0;i<get_factors();i++) if(cline[i]>0) ncombins*=get_levels(i);
+ sums = new double[ncombins*nr];
+ memset(sums,0,ncombins*nr*sizeof(double));
+ for(t=first;t;t=t->next){
+  c=0;
+  for(i=0;i<get_factors();i++) if(cline[i]>0) c=c*get_levels(i)+t->codes[i];
+  add_values(sums+c*nr,t->vec+r0,nr);
+ }
+ memset(ss,0,nr*sizeof(double));
+ for(c=0;c<ncombins;c++) add_squares(ss,sums+c*nr,nr);
+ for(i=0;i<nr;i++) ss[i]/=(double) get_nt()/ncombins;
+ delete [] sums;
+}
+
+//------------------------------------------------------------------------//
+// These functions return in 'v' the correction term, the sum of squared  //
+// values and the error sum of squares of the 'nr' responses from 'r0' on //
+//------------------------------------------------------------------------//
+
+void data::get_CT(double *v, int r0, int nr)
+{
+ partial *t;
+ int     i;
+
+ memset(v,0,nr*sizeof(double));
+ for(t=first;t;t=t->next) add_values(v,t->vec+r0,nr);
+ for(i=0;i<nr;i++) v[i]=pow(v[i],2)/get_nt();
+}
+
+void data::get_sum_of_squares(double *v, int r0, int nr)
+{
+ partial *t;
+
+ memset(v,0,nr*sizeof(double));
+ for(t=first;t;t=t->next) add_values(v,t->vec+resp->n+r0,nr);
+}
+
+void data::get_error_ss(double *v, int r0, int nr)
+{
+ partial *t;
+ double  *sum;
+ int     i;
+
+ sum = new double[nr];
+ memset(sum,0,nr*sizeof(double));
+ for(t=first;t;t=t->next) add_squares(sum,t->vec+r0,nr);
+ get_sum_of_squares(v,r0,nr);
+ for(i=0;i<nr;i++) v[i]-=sum[i]/get_n();
+ delete [] sum;
+}
+
+//------------------------------------------------------------------------//
+// This function adjusts the 'n' P values at 'p' for the false discovery  //
+// rate (Benjamini-Hochberg): the i-th smallest of them is multiplied by  //
+// n/i, and adjusted values are kept in order. Negative P values (no      //
+// test) are left out.                                                    //
+//------------------------------------------------------------------------//
+
+static void benjamini_hochberg(const double *p, double *q, int n)
+{
+ int    *order,m,i;
+ double adj;
+
+ order = new int[n];
+ m=0;
+ for(i=0;i<n;i++){
+  q[i]=p[i];
+  if(p[i]>=0) order[m++]=i;
+ }
+ sort(order,order+m,[p](int a, int b){ return p[a]<p[b]; });
+ adj=1;
+ for(i=m-1;i>=0;i--){
+  adj=min(adj,p[order[i]]*m/(i+1));
+  q[order[i]]=adj;
+ }
+ delete [] order;
+}
+
+//------------------------------------------------------------------------//
+// This function writes the ANOVA of all responses, once the model has    //
+// been built and the F tests chosen (ctrules) from the first response.   //
+// Each term of the orthogonal model (a combination of factors) goes into //
+// the term of the model with the same codes once nested factors are      //
+// marked (build_model), and its sums of squares are partial sums of      //
+// squares with signs (get_SS), so each partial sum of squares is added,  //
+// with the sum of its signs, to the terms of the model it belongs to.    //
+// The design is written once, then a row per response and term.          //
+//------------------------------------------------------------------------//
+
+void model::write_responses()
+{
+ term     **terms,*t;
+ CODES    code;
+ double   *SS,*P,*Q,*pss,ms,msa,F;
+ int      *coef,*ctcoef,*against;
+ int      nterms,nresp,ncombins,c,d,f,i,j,r,r0,nr;
+ unsigned NS,NR,NT;
+
+ nresp=get_responses();
+ nterms=0;
+ for(t=first;t;t=t->next) nterms++;
+ terms = new term*[nterms];
+ for(t=first,f=0;t;t=t->next) terms[f++]=t;
+
+ // Signs of partial sums of squares (and of the correction term) in the
+ // sums of squares of each term; the Error is the last term
+
+ ncombins=1<<get_factors();
+ coef = new int[ncombins*nterms];
+ ctcoef = new int[nterms];
+ memset(coef,0,ncombins*nterms*sizeof(int));
+ memset(ctcoef,0,nterms*sizeof(int));
+ for(c=1;c<ncombins;c++){
+  memset(code,0,sizeof(code));
+  for(i=0;i<get_factors();i++) if((c>>i)&1) code[i]=1;
+  if(!show_orthogonal()){
+   for(i=0;i<get_factors();i++){
+    if(((c>>i)&1)&&is_nested(i)){
+     for(j=0;j<get_factors();j++) if(is_nested_into(i,j)) code[j]=2;
+    }
+   }
+  }
+  for(f=0;f<nterms-1;f++) if(memcmp(terms[f]->fcode,code,MAXFACTORS)==0) break;
+  if(f==nterms-1) continue;
+  for(d=c;d>0;d=(d-1)&c){
+   coef[d*nterms+f]+=((__builtin_popcount(c)-__builtin_popcount(d))%2)?-1:1;
+  }
+  ctcoef[f]+=(__builtin_popcount(c)%2)?-1:1;
+ }
+
+ // Sums of squares of all responses, RESPBLOCK responses at a time
+
+ SS = new double[nterms*nresp];
+ memset(SS,0,nterms*nresp*sizeof(double));
+ pss = new double[RESPBLOCK];
+ for(r0=0;r0<nresp;r0+=RESPBLOCK){
+  nr=min(RESPBLOCK,nresp-r0);
+  for(d=1;d<ncombins;d++){
+   for(f=0;(f<nterms)&&(coef[d*nterms+f]==0);f++);
+   if(f==nterms) continue;
+   memset(code,0,sizeof(code));
+   for(i=0;i<get_factors();i++) if((d>>i)&1) code[i]=1;
+   get_partial_SS(code,pss,r0,nr);
+   for(f=0;f<nterms;f++){
+    if(coef[d*nterms+f]==0) continue;
+    for(r=0;r<nr;r++) SS[f*nresp+r0+r]+=coef[d*nterms+f]*pss[r];
+   }
+  }
+  get_CT(pss,r0,nr);
+  for(f=0;f<nterms;f++){
+   for(r=0;r<nr;r++) SS[f*nresp+r0+r]+=ctcoef[f]*pss[r];
+  }
+  get_error_ss(SS+(nterms-1)*nresp+r0,r0,nr);
+ }
+
+ // F tests, against the same terms as the first response
+
+ against = new int[nterms];
+ P = new double[nterms*nresp];
+ Q = new double[nterms*nresp];
+ for(f=0;f<nterms;f++){
+  against[f]=-1;
+  for(i=0;(i<nterms)&&(f<nterms-1);i++){
+   if((i!=f)&&(strcmp(terms[f]->against,terms[i]->name)==0)) against[f]=i;
+  }
+  for(r=0;r<nresp;r++){
+   P[f*nresp+r]=-1;
+   if((against[f]<0)||(terms[f]->df<=0)||(terms[against[f]]->df<=0)) continue;
+   msa=SS[against[f]*nresp+r]/terms[against[f]]->df;
+   if(msa>0){
+    F=(SS[f*nresp+r]/terms[f]->df)/msa;
+    P[f*nresp+r]=fprob(F,terms[f]->df,terms[against[f]]->df);
+   }
+  }
+  if(adjust_fdr()) benjamini_hochberg(P+f*nresp,Q+f*nresp,nresp);
+ }
+
+ // Design, written once
+
+ NS=20;
+ for(f=0;f<nterms;f++) if(strlen(terms[f]->name)>NS) NS=strlen(terms[f]->name);
+ NR=9;
+ for(r=0;r<nresp;r++) if(strlen(get_response_name(r))+1>NR) NR=strlen(get_response_name(r))+1;
+ header(" Design ");
+ cout << resetiosflags(ios::right) << setiosflags(ios::left) << setw(NS) << "Source of Variation";
+ cout << resetiosflags(ios::left) << setiosflags(ios::right);
+ cout << setw(DFSIZE) << "DF" << " Against" << endl;
+ footer();
+ for(f=0;f<nterms;f++){
+  cout << resetiosflags(ios::right) << setiosflags(ios::left) << setw(NS) << terms[f]->name;
+  cout << resetiosflags(ios::left) << setiosflags(ios::right) << setw(DFSIZE) << terms[f]->df;
+  if(against[f]>=0) cout << " " << terms[against[f]]->name;
+  cout << endl;
+ }
+ footer();
+
+ // A row per response and term, in columns of responses and terms only as
+ // wide as their names, so rows fit in ROWSIZE unless names are long
+
+ NT=7;
+ for(f=0;f<nterms;f++) if(strlen(terms[f]->name)+1>NT) NT=strlen(terms[f]->name)+1;
+ header(" ANOVA Results ");
+ cout << resetiosflags(ios::right) << setiosflags(ios::left);
+ cout << setw(NR) << "Response" << setw(NT) << "Source";
+ cout << resetiosflags(ios::left) << setiosflags(ios::right);
+ cout << setw(SSSIZE) << "SS" << setw(MSSIZE) << "MS";
+ cout << setw(FRSIZE) << "FR" << setw(PRSIZE) << "P";
+ if(adjust_fdr()) cout << setw(PRSIZE) << "Q";
+ cout << endl;
+ footer();
+ for(r=0;r<nresp;r++){
+  for(f=0;f<nterms;f++){
+   ms=(terms[f]->df>0)?SS[f*nresp+r]/terms[f]->df:0;
+   cout << resetiosflags(ios::right|ios::fixed) << setiosflags(ios::left);
+   cout << setw(NR) << get_response_name(r) << setw(NT) << terms[f]->name;
+   cout << resetiosflags(ios::left) << setiosflags(ios::right|ios::fixed);
+   cout << setprecision(PRECISION);
+   cout << setw(SSSIZE) << SS[f*nresp+r] << setw(MSSIZE) << ms;
+   if(P[f*nresp+r]>=0){
+    cout << setw(FRSIZE) << ms/(SS[against[f]*nresp+r]/terms[against[f]]->df);
+    cout << setw(PRSIZE) << P[f*nresp+r];
+    if(adjust_fdr()) cout << setw(PRSIZE) << Q[f*nresp+r];
+   }
+   else if(f<nterms-1){
+    cout << setw(FRSIZE) << "-" << setw(PRSIZE) << "-";
+    if(adjust_fdr()) cout << setw(PRSIZE) << "-";
+   }
+   cout << endl;
+  }
+ }
+ footer();
+
+ delete [] terms;
+ delete [] coef;
+ delete [] ctcoef;
+ delete [] SS;
+ delete [] pss;
+ delete [] against;
+ delete [] P;
+ delete [] Q;
+}
+
+#endif
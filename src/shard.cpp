@@ -0,0 +1,400 @@
+// shard.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file writes shards of summarized data ('--shard') and merges them
+// ('--merge'), so data spread over several hosts can be analysed together
+// by moving only the sums of its cells. A shard holds the factors, their
+// levels by name and, for each combination of levels, the number of
+// replicates and the sum and sum of squares of its values. Shards are
+// merged by matching factors and levels by name, so each host may find
+// levels in any order, or only some of them. The levels of merged shards
+// are sorted by name, and so are their cells, whatever the order of shards.
+//
+// Sums are merged exactly: each one is kept as an expansion, a list of
+// doubles which do not overlap and whose exact sum is the sum of all the
+// values added (as math.fsum of Python does), and only rounded to a double
+// once all shards are merged. A shard written from merged shards keeps the
+// expansions, so merging is associative: merging shards in any order or
+// grouping yields the same sums, the sums of the shards correctly rounded.
+// Shards of data files keep the sums of their values as they were added
+// while the file was read, so merged shards of parts of a data file may
+// differ from the whole file read at once in the last bits of their sums.
+// All integers are unsigned and little-endian, as are doubles:
+//
+//   "MWS1"                     magic number (4 bytes)
+//   uint32  version            currently 1
+//   uint32  factors            number of factors
+//   uint32  0
+//   uint64  cells              number of combinations of factor levels
+//   for each factor:
+//     uint8   type             0 - fixed, 1 - random
+//     uint8   0
+//     uint16  length, bytes    name of the factor
+//     uint32  levels           number of levels
+//     for each level:
+//       uint16  length, bytes  name of the level
+//   uint16  length, bytes      name of the data variable
+//
+// After the header, padded with zeros to a multiple of 8 bytes, there is a
+// record for each combination: its level codes (uint32 each, padded to a
+// multiple of 8 bytes), its number of replicates (uint64), the number of
+// terms of the expansions of its sum and of its sum of squares (uint32
+// each) and the terms of both (doubles). Sums are of transformed values.
+
+#ifndef CGI
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "data.h"
+#include "binary.h"
+
+using namespace std;
+
+// Exact sums of a cell: expansions of its sum and sum of squares
+
+struct exactcell{
+ vector<double> sum;
+ vector<double> sum2;
+};
+
+// Exact sums of all cells of the merged shards
+
+struct merger{
+ unordered_map<partial *,exactcell> cells;
+ set<string> names[MAXFACTORS];	// Levels of all shards, by name
+ int shards;
+};
+
+//------------------------------------------------------------------------//
+// This function adds 'x' to the expansion 'p', exactly. Terms are kept   //
+// in increasing order of magnitude and do not overlap (Shewchuk's grow-  //
+// expansion, with zero terms removed).                                   //
+//------------------------------------------------------------------------//
+
+static void add_exact(vector<double> &p, double x)
+{
+ double y,hi,lo;
+ size_t i,j;
+
+ for(i=j=0;j<p.size();j++){
+  y=p[j];
+  if(fabs(x)<fabs(y)) swap(x,y);
+  hi=x+y;
+  lo=y-(hi-x);
+  if(lo!=0) p[i++]=lo;
+  x=hi;
+ }
+ p.resize(i);
+ if((x!=0)||p.empty()) p.push_back(x);
+}
+
+//------------------------------------------------------------------------//
+// This function returns the sum of the expansion 'p' correctly rounded   //
+// to a double (ties to even).                                            //
+//------------------------------------------------------------------------//
+
+static double round_exact(const vector<double> &p)
+{
+ double hi,lo,x,y;
+ int    n;
+
+ if(p.empty()) return 0;
+ n=p.size()-1;
+ hi=p[n];
+ lo=0;
+ while(n>0){
+  x=hi;
+  y=p[--n];
+  hi=x+y;
+  lo=y-(hi-x);
+  if(lo!=0) break;
+ }
+ if((n>0)&&(((lo<0)&&(p[n-1]<0))||((lo>0)&&(p[n-1]>0)))){
+  y=lo*2;
+  x=hi+y;
+  if(y==x-hi) hi=x;
+ }
+ return hi;
+}
+
+//------------------------------------------------------------------------//
+// This function adds the levels of the shard mapped between 's' and      //
+// 'e' to the data merged so far or, if 'levels' is false, its cells.     //
+// Factors are set from the first shard; the others must have the same    //
+// factors, in any order. It returns false if the shard is not valid.     //
+//------------------------------------------------------------------------//
+
+bool data::load_shard(const char *s, const char *e, bool levels)
+{
+ const char *p;
+ LEVCODES   cline;
+ partial    *t;
+ exactcell  *x;
+ vector<int> map[MAXFACTORS];
+ int        fmap[MAXFACTORS];
+ uint64_t   ncells,c,terms,terms2,k;
+ uint32_t   nlev,l;
+ int        nfact,f,g,len,type,rec;
+ char       name[MAXNAME+1];
+ bool       first_shard;
+
+ if((e-s<24)||(memcmp(s,"MWS1",4)!=0)||(get_le(s+4,4)!=1)) return false;
+ nfact=get_le(s+8,4);
+ ncells=get_le(s+16,8);
+ first_shard=(get_factors()==0);
+ if((nfact<1)||(nfact>MAXFACTORS)||(!first_shard&&(nfact!=get_factors()))) return false;
+ p=s+24;
+
+ // Factors, matched by name, and their levels, coded as in earlier shards
+
+ for(f=0;f<nfact;f++){
+  if(e-p<4) return false;
+  type=(unsigned char) p[0];
+  len=get_le(p+2,2);
+  p+=4;
+  if(e-p<len+4) return false;
+  memcpy(name,p,len>MAXNAME?MAXNAME:len);
+  name[len>MAXNAME?MAXNAME:len]=0;
+  if(first_shard){
+   if(!set_factor(name)) return false;
+   set_factor_type(f,type==RANDOM?RANDOM:FIXED);
+   fmap[f]=f;
+  }
+  else{
+   for(g=0;(g<get_factors())&&(strcmp(name,get_factor_name(g))!=0);g++);
+   if(g==get_factors()) return false;
+   fmap[f]=g;
+  }
+  p+=len;
+  nlev=get_le(p,4);
+  p+=4;
+  for(l=0;l<nlev;l++){
+   if(e-p<2) return false;
+   len=get_le(p,2);
+   if(e-p<len+2) return false;
+   if(levels) merged->names[fmap[f]].insert(string(p+2,len));
+   else map[f].push_back(set_code(fmap[f],string_view(p+2,len)));
+   p+=len+2;
+  }
+ }
+ if(e-p<2) return false;
+ len=get_le(p,2);
+ if(e-p<len+2) return false;
+ memcpy(name,p+2,len>MAXNAME?MAXNAME:len);
+ name[len>MAXNAME?MAXNAME:len]=0;
+ if(first_shard) set_data_name(name);
+ else if(strcmp(name,data_name)!=0) return false;
+ p+=len+2;
+ if(levels) return true;
+
+ // Cells
+
+ if((p-s)%8) p+=8-(p-s)%8;
+ rec=(4*nfact+7)/8*8;
+ memset(cline,0,sizeof(cline));
+ for(c=0;c<ncells;c++){
+  if((uint64_t) (e-p)<(uint64_t) rec+16) return false;
+  for(f=0;f<nfact;f++){
+   k=get_le(p+4*f,4);
+   if(k>=map[f].size()) return false;
+   cline[fmap[f]]=map[f][k];
+  }
+  p+=rec;
+  t=get_partial(cline);
+  t->n+=get_le(p,8);
+  nt+=get_le(p,8);
+  terms=get_le(p+8,4);
+  terms2=get_le(p+12,4);
+  p+=16;
+  if((uint64_t) (e-p)/8<terms+terms2) return false;
+  x=&merged->cells[t];
+  for(k=0;k<terms;k++,p+=8) add_exact(x->sum,get_double(p));
+  for(k=0;k<terms2;k++,p+=8) add_exact(x->sum2,get_double(p));
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function reads the shards given with '--merge', instead of data   //
+// files: first their levels, which are coded in order of their names,    //
+// then their cells. It sets the sums of each cell to its exact sum,      //
+// rounded.                                                               //
+//------------------------------------------------------------------------//
+
+bool data::read_shards()
+{
+ struct stat st;
+ partial     *t;
+ exactcell   *x;
+ void        *m;
+ set<string>::iterator i;
+ int         fd,k,f,pass;
+ bool        ok;
+
+ if(rows||pipeline()||(strlen(snapshot_file_name())>0)||projected()||cands||resp||split||
+    (pretransform()!=NOTRANSF)||(transformation()!=NOTRANSF)||(mem_limit()>0)){
+  cerr << "Shards can only be merged as they are (transformations are applied when they are written)!... Exiting..." << endl;
+  return false;
+ }
+ merged = new merger;
+ merged->shards=0;
+ ok=true;
+ for(pass=0;(pass<2)&&ok;pass++){
+  if(pass==1){
+   for(f=0;f<get_factors();f++){
+    for(i=merged->names[f].begin();i!=merged->names[f].end();i++) set_code(f,*i);
+   }
+  }
+  for(k=0;(k<data_files())&&ok;k++){
+   set_data_file(k);
+   fd=open(data_file_name(),O_RDONLY);
+   if(fd<0){
+    cerr << "Error while opening " << data_file_name() << "!... Exiting..." << endl;
+    return false;
+   }
+   m=MAP_FAILED;
+   if((fstat(fd,&st)==0)&&(st.st_size>0)){
+    m=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+   }
+   close(fd);
+   ok=(m!=MAP_FAILED)&&load_shard((const char *) m,(const char *) m+st.st_size,pass==0);
+   if(m!=MAP_FAILED) munmap(m,st.st_size);
+   if(!ok) cerr << "Invalid shard " << data_file_name() << "!... Exiting..." << endl;
+   if(pass==1) merged->shards++;
+  }
+ }
+ if(!ok) return false;
+ for(t=first;t;t=t->next){
+  x=&merged->cells[t];
+  t->sum=round_exact(x->sum);
+  t->sum2=round_exact(x->sum2);
+ }
+ if(be_verbose()){
+  cout << "Merged " << merged->shards << " shards into " << npartials << " cells" << endl;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function writes the data read (or merged) to the shard given with //
+// '--shard'. Sums of merged shards are written as their expansions.      //
+//------------------------------------------------------------------------//
+
+bool data::write_shard()
+{
+ ofstream       out;
+ string         tmp;
+ partial        *t;
+ vector<double> one(1),one2(1);
+ const vector<double> *s,*s2;
+ exactcell      *x;
+ uint64_t       written;
+ size_t         k;
+ int            f,l;
+
+ if(spill&&!gather_spill()) return false;
+ tmp=string(shard_file_name())+".tmp";
+ out.open(tmp,ios::out|ios::binary|ios::trunc);
+ if(!out){
+  cerr << "Error while opening " << tmp << "!... Exiting..." << endl;
+  return false;
+ }
+
+ // Header
+
+ out.write("MWS1",4);
+ put_le(out,1,4);
+ put_le(out,get_factors(),4);
+ put_le(out,0,4);
+ put_le(out,npartials,8);
+ written=24;
+ for(f=0;f<get_factors();f++){
+  put_le(out,get_factor_type(f),1);
+  put_le(out,0,1);
+  put_name(out,get_factor_name(f));
+  put_le(out,get_levels(f),4);
+  written+=8+strlen(get_factor_name(f));
+  for(l=0;l<get_levels(f);l++){
+   put_name(out,get_code_name(f,l));
+   written+=2+strlen(get_code_name(f,l));
+  }
+ }
+ put_name(out,data_name);
+ written+=2+strlen(data_name);
+ put_padding(out,written);
+
+ // Cells
+
+ for(t=first;t;t=t->next){
+  for(f=0;f<get_factors();f++) put_le(out,t->orig[f],4);
+  put_padding(out,4*get_factors());
+  if(merged){
+   x=&merged->cells[t];
+   s=&x->sum;
+   s2=&x->sum2;
+  }
+  else{
+   one[0]=t->sum;
+   one2[0]=t->sum2;
+   s=&one;
+   s2=&one2;
+  }
+  put_le(out,t->n,8);
+  put_le(out,s->size(),4);
+  put_le(out,s2->size(),4);
+  for(k=0;k<s->size();k++) put_double(out,(*s)[k]);
+  for(k=0;k<s2->size();k++) put_double(out,(*s2)[k]);
+ }
+ out.close();
+ if(!out||(rename(tmp.c_str(),shard_file_name())!=0)){
+  cerr << "Error while writing " << shard_file_name() << "!... Exiting..." << endl;
+  remove(tmp.c_str());
+  return false;
+ }
+ if(be_verbose()){
+  cout << "Wrote " << npartials << " cells of " << nt << " observations to shard " << shard_file_name() << endl;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function removes the exact sums of merged shards                  //
+//------------------------------------------------------------------------//
+
+void data::stop_merge()
+{
+ delete merged;
+ merged=NULL;
+}
+
+#endif
@@ -0,0 +1,301 @@
+// spill.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file keeps the cells of designs too large for memory on disk
+// ('--mem-limit'). While the data file is read, cells are summed in memory
+// as usual until they fill the memory limit. They are then written to
+// SPILLPARTS temporary files (runs), each cell to the run chosen by the
+// hash of its level codes, and the cells in memory are cleared. Once the
+// data file is read, the runs are summed one at a time, so only the cells
+// of one run are held in the hash index at once, and the cells found are
+// moved to a temporary file mapped into memory. The analysis then walks
+// them as usual, while the system keeps in memory only the pages in use.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "data.h"
+
+using namespace std;
+
+#define SPILLPARTS  64		// Runs of cells written to disk
+#define SPILLBLOCK  4096	// Cells read back from a run at once
+
+// A cell, as written to a run
+
+struct spillcell{
+ LEVCODES codes;
+ int      n;
+ double   sum;
+ double   sum2;
+};
+
+// Runs of cells written to disk, and the file where the cells of the
+// design are kept once the data file is read
+
+struct spiller{
+ FILE   *runs[SPILLPARTS];
+ long   maxcells;		// Cells kept in memory while reading
+ long   spilled;		// Cells written to runs
+ int    nspills;		// Times cells were written to runs
+ int    fd;			// File of the cells of the design...
+ partial *cells;		// ...mapped into memory
+ size_t size;
+};
+
+//------------------------------------------------------------------------//
+// This function opens a temporary file, in $TMPDIR or /tmp, which is     //
+// removed as soon as it is closed. It returns its descriptor, or -1.     //
+//------------------------------------------------------------------------//
+
+static int temp_file()
+{
+ const char *dir;
+ char       name[256];
+ int        fd;
+
+ dir=getenv("TMPDIR");
+ if(!dir||(strlen(dir)==0)) dir="/tmp";
+ snprintf(name,sizeof(name),"%s/mwanova.XXXXXX",dir);
+ fd=mkstemp(name);
+ if(fd>=0) unlink(name);
+ return fd;
+}
+
+//------------------------------------------------------------------------//
+// This function starts keeping cells on disk, with '--mem-limit'. The    //
+// limit is shared between cells and their hash index. It returns false   //
+// if cells cannot be kept on disk for this data.                         //
+//------------------------------------------------------------------------//
+
+bool data::start_spill()
+{
+ int i,fd;
+
+ if(rows||(data_files()>1)||resp||split){
+  cerr << "Only the cells of a single data file, with a single response, can be kept on disk!... Exiting..." << endl;
+  return false;
+ }
+ spill = new spiller;
+ memset(spill,0,sizeof(spiller));
+ spill->fd=-1;
+ spill->maxcells=mem_limit()/(sizeof(partial)+4*sizeof(partial *));
+ if(spill->maxcells<1024) spill->maxcells=1024;
+ for(i=0;i<SPILLPARTS;i++){
+  fd=temp_file();
+  if((fd<0)||!(spill->runs[i]=fdopen(fd,"w+b"))){
+   cerr << "Cannot create temporary files to keep cells on disk!... Exiting..." << endl;
+   return false;
+  }
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function writes all cells in memory to their runs, and clears     //
+// them and their hash index.                                             //
+//------------------------------------------------------------------------//
+
+void data::spill_cells()
+{
+ partial   *t,*u;
+ spillcell c;
+
+ memset(&c,0,sizeof(c));
+ for(t=first;t;t=u){
+  u=t->next;
+  memcpy(c.codes,t->orig,sizeof(LEVCODES));
+  c.n=t->n;
+  c.sum=t->sum;
+  c.sum2=t->sum2;
+  fwrite(&c,sizeof(c),1,spill->runs[hash_codes(t->orig)>>26]);
+  delete t;
+ }
+ spill->spilled+=npartials;
+ spill->nspills++;
+ first=last=NULL;
+ npartials=0;
+ memset(cells,0,ncells*sizeof(partial *));
+}
+
+//------------------------------------------------------------------------//
+// This function is called by get_partial before a new cell is created.   //
+// If the cell would overfill the memory limit while the data file is     //
+// read, the cells in memory are written to their runs first, and true is //
+// returned, since the hash index was cleared.                            //
+//------------------------------------------------------------------------//
+
+bool data::make_room()
+{
+ if(spill->cells||(npartials<spill->maxcells)) return false;
+ spill_cells();
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function sums the runs of cells written while reading, one run at //
+// a time, and moves the cells of each one to the mapped file, linked in  //
+// a list as if they had been summed in memory. It is called once the     //
+// data file is read, or before a snapshot is written. It returns false   //
+// if the runs cannot be read back.                                       //
+//------------------------------------------------------------------------//
+
+bool data::gather_spill()
+{
+ spillcell *b;
+ partial   *t,*u,*p,*head,*tail;
+ size_t    got,i;
+ long      moved,total;
+ int       r;
+ bool      ok;
+ void      *m;
+
+ if(spill->cells||(spill->nspills==0)) return true;	// Gathered, or all in memory
+ spill_cells();
+ for(r=0;r<SPILLPARTS;r++){
+  if(fflush(spill->runs[r])!=0){
+   cerr << "Error while writing cells to a temporary file!... Exiting..." << endl;
+   return false;
+  }
+ }
+
+ // The design has at most as many cells as were written
+
+ spill->size=spill->spilled*sizeof(partial);
+ spill->fd=temp_file();
+ if((spill->fd<0)||(ftruncate(spill->fd,spill->size)!=0)){
+  cerr << "Cannot create a temporary file to keep cells on disk!... Exiting..." << endl;
+  return false;
+ }
+ m=mmap(NULL,spill->size,PROT_READ|PROT_WRITE,MAP_SHARED,spill->fd,0);
+ if(m==MAP_FAILED){
+  cerr << "Cannot map the temporary file of cells!... Exiting..." << endl;
+  return false;
+ }
+ spill->cells=(partial *) m;
+
+ b = new spillcell[SPILLBLOCK];
+ head=tail=NULL;
+ total=0;
+ ok=true;
+ for(r=0;(r<SPILLPARTS)&&ok;r++){
+  rewind(spill->runs[r]);
+  while((got=fread(b,sizeof(spillcell),SPILLBLOCK,spill->runs[r]))>0){
+   for(i=0;i<got;i++){
+    t=get_partial(b[i].codes);
+    t->sum+=b[i].sum;
+    t->sum2+=b[i].sum2;
+    t->n+=b[i].n;
+   }
+  }
+  if(ferror(spill->runs[r])) ok=false;
+  fclose(spill->runs[r]);
+  spill->runs[r]=NULL;
+
+  // Move the cells of this run to the mapped file
+
+  moved=0;
+  for(t=first;t;t=u){
+   u=t->next;
+   p=&spill->cells[total+moved++];
+   *p=*t;
+   p->next=NULL;
+   p->prev=tail;
+   if(tail) tail->next=p;
+   else head=p;
+   tail=p;
+   delete t;
+  }
+  total+=moved;
+  first=last=NULL;
+  npartials=0;
+  memset(cells,0,ncells*sizeof(partial *));
+ }
+ delete [] b;
+ if(!ok){
+  cerr << "Error while reading cells from a temporary file!... Exiting..." << endl;
+  return false;
+ }
+ first=head;
+ last=tail;
+ npartials=total;
+ delete [] cells;			// No more cells are looked up
+ cells=NULL;
+ ncells=0;
+ if(be_verbose()){
+  cout << "Kept " << total << " cells on disk (" << spill->spilled << " written in ";
+  cout << spill->nspills << " spills)" << endl;
+ }
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function maps a new temporary file of 'size' bytes into memory,   //
+// for other tables of cells which must not be held in memory either. It  //
+// returns NULL if the file cannot be created or mapped.                  //
+//------------------------------------------------------------------------//
+
+void *data::map_spill(size_t size)
+{
+ void *m;
+ int  fd;
+
+ fd=temp_file();
+ if((fd<0)||(ftruncate(fd,size)!=0)){
+  if(fd>=0) close(fd);
+  cerr << "Cannot create a temporary file to keep cells on disk!... Exiting..." << endl;
+  return NULL;
+ }
+ m=mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+ close(fd);				// The mapping keeps the file
+ if(m==MAP_FAILED){
+  cerr << "Cannot map a temporary file of cells!... Exiting..." << endl;
+  return NULL;
+ }
+ return m;
+}
+
+//------------------------------------------------------------------------//
+// This function removes the runs and the mapped file of cells, which     //
+// holds all the list of cells if the runs were gathered.                 //
+//------------------------------------------------------------------------//
+
+void data::stop_spill()
+{
+ int i;
+
+ for(i=0;i<SPILLPARTS;i++) if(spill->runs[i]) fclose(spill->runs[i]);
+ if(spill->cells){
+  munmap(spill->cells,spill->size);
+  first=last=NULL;
+ }
+ if(spill->fd>=0) close(spill->fd);
+ delete spill;
+ spill=NULL;
+}
+
+#endif
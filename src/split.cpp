@@ -0,0 +1,181 @@
+// split.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file analyses groups of rows apart ('--split-by'), as if each group
+// was a data file of its own. While the data file is read, each row is
+// added to the cells of its group, named by the value of the column given
+// with '--split-by'. Each group then gets its own model, with the levels
+// found in the group only. Models are fitted by a pool of threads, since
+// fitting writes nothing, and their results are written in turn, in the
+// order groups were found in the data file.
+
+#ifndef CGI
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include "model.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------//
+// This function starts splitting rows into groups, with '--split-by'. It //
+// returns false if rows cannot be split this way.                        //
+//------------------------------------------------------------------------//
+
+bool data::start_split()
+{
+ if(rows||pipeline()||(strlen(snapshot_file_name())>0)||(data_files()>1)||
+    compare_transforms()||resp){
+  cerr << "Only a single data file can be split, with no other way of reading it!... Exiting..." << endl;
+  return false;
+ }
+ split = new splitter;
+ memset(split,0,sizeof(splitter));
+ split->col=-1;
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function adds an observation with level codes 'cline' and value   //
+// 'val' to the cells of the group of the line being parsed. Values are   //
+// transformed here, one at a time, since batches would mix groups.       //
+//------------------------------------------------------------------------//
+
+void data::add_split(LEVCODES cline, double val)
+{
+ data **g;
+
+ if(split->group>=split->maxgroups){
+  g = new data*[split->names.maxnames];
+  memset(g,0,split->names.maxnames*sizeof(data *));
+  if(split->groups){
+   memcpy(g,split->groups,split->maxgroups*sizeof(data *));
+   delete [] split->groups;
+  }
+  split->groups=g;
+  split->maxgroups=split->names.maxnames;
+ }
+ if(!split->groups[split->group]) split->groups[split->group] = new data;
+ if(kernel) kernel(&val,1);
+ split->groups[split->group]->add_code_line(cline,val);
+ split->groups[split->group]->nt++;
+}
+
+//------------------------------------------------------------------------//
+// This function removes the groups of rows (their names are freed with   //
+// the other dictionaries)                                                //
+//------------------------------------------------------------------------//
+
+void data::stop_split()
+{
+ int i;
+
+ if(split->groups){
+  for(i=0;i<split->maxgroups;i++) if(split->groups[i]) delete split->groups[i];
+  delete [] split->groups;
+ }
+ delete split;
+ split=NULL;
+}
+
+//------------------------------------------------------------------------//
+// These functions return the number of groups of rows (0 if rows are not //
+// split) and the name of group 'g'.                                      //
+//------------------------------------------------------------------------//
+
+int data::get_groups()
+{
+ return split?split->names.nnames:0;
+}
+
+const char *data::get_group_name(int g)
+{
+ return split->names.names[g];
+}
+
+//------------------------------------------------------------------------//
+// This function copies group 'g' of the rows read by 'from' into this    //
+// data, which will not report errors since it is analysed in a thread.   //
+//------------------------------------------------------------------------//
+
+void data::take_group(data *from, int g)
+{
+ copy_cells(from,from->split->groups[g]->first);
+ quiet=true;
+}
+
+//------------------------------------------------------------------------//
+// This function fits a model to each group of rows, in up to 'workers()' //
+// threads (or as many as there are processors if '--threads' is not      //
+// given), and then writes their results in the order of the groups.      //
+//------------------------------------------------------------------------//
+
+void model::run_groups()
+{
+ model       **m;
+ thread      *th;
+ bool        *ok;
+ atomic<int> next(0);
+ char        h[ROWSIZE+1];
+ int         ngroups,nthreads,g,i;
+ ios::fmtflags flags;
+ streamsize  prec;
+
+ ngroups=get_groups();
+ nthreads=workers(ngroups);
+
+ m = new model*[ngroups];
+ ok = new bool[ngroups];
+ for(g=0;g<ngroups;g++){
+  m[g] = new model;
+  *(base *) m[g]=*(base *) this;
+  m[g]->take_group(this,g);
+  ok[g]=false;
+ }
+ th = new thread[nthreads];
+ for(i=0;i<nthreads;i++){
+  th[i]=thread([=,&next]{
+   int k;
+   while((k=next.fetch_add(1))<ngroups) ok[k]=m[k]->fit();
+  });
+ }
+ for(i=0;i<nthreads;i++) th[i].join();
+
+ flags=cout.flags();			// Each group formats output anew
+ prec=cout.precision();
+ for(g=0;g<ngroups;g++){
+  snprintf(h,sizeof(h)," %s = %s ",split_by(),get_group_name(g));
+  header(h);
+  if(ok[g]) m[g]->report();
+  else cerr << "There are missing combinations of factor levels in this group!" << endl;
+  cout.flags(flags);
+  cout.precision(prec);
+  delete m[g];
+ }
+ delete [] th;
+ delete [] ok;
+ delete [] m;
+}
+
+#endif
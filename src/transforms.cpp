@@ -0,0 +1,273 @@
+// transforms.cpp
+//
+// mwanova - Multi-Way Analysis of Variance.
+// Copyright (C) 2001  Antonio Santos (amsantos@fc.up.pt)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// *************************************************************************
+//
+// This file compares transformations of the data ('--transforms'). While the
+// data file is read, each value is transformed with all transformations of
+// -t and with Box-Cox transformations for lambdas from -2 to 2, in steps of
+// 0.5, and the sums and sums of squares of all of them are kept for each
+// combination of factor levels. Once the file is read, the homogeneity tests
+// of data::test_homogeneity and the error mean square are reported for
+// each transformation, so choosing one takes a single reading of the data.
+// The pre-transformation (-p), if any, is applied before all of them.
+//
+// Error mean squares of Box-Cox transformations are those of the values
+// divided by the geometric mean of the data to the power lambda-1, which
+// have the same units for all lambdas, so the lambda with the smallest
+// error mean square is the one with the largest likelihood.
+
+#ifndef CGI
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include "data.h"
+#include "probs.h"
+
+using namespace std;
+
+#define BOXCOX      6		// First Box-Cox transformation
+#define CANDIDATES  15		// Transformations compared
+
+static const char *candidate_name[CANDIDATES]={
+ "none","sqrt","ln","log","arcsin","asin",
+ "Box-Cox -2","Box-Cox -1.5","Box-Cox -1","Box-Cox -0.5","Box-Cox 0",
+ "Box-Cox 0.5","Box-Cox 1","Box-Cox 1.5","Box-Cox 2"
+};
+
+// Sums and sums of squares of the values of a combination of factor levels
+// under each transformation
+
+struct candcell{
+ LEVCODES codes;
+ int      n;
+ double   sum[CANDIDATES];
+ double   sum2[CANDIDATES];
+};
+
+// Hash table of the combinations of factor levels, keyed on level codes
+
+struct candidates{
+ candcell **cells;
+ int      ncells;
+ int      ncombins;
+};
+
+//------------------------------------------------------------------------//
+// This function computes the value 'v' under all transformations. Box-   //
+// Cox transformations use powers of the square root of 'v', since all    //
+// lambdas are multiples of 0.5.                                          //
+//------------------------------------------------------------------------//
+
+static void transform_all(double v, double *y)
+{
+ double r,p[5];
+ int    h;
+
+ r=sqrt(v);
+ y[0]=v;
+ y[1]=r;
+ y[2]=log(v+1);
+ y[3]=log10(v+1);
+ y[4]=asin(r)*90/(M_PI/2);
+ y[5]=asin(r);
+ p[0]=1;
+ p[1]=r;
+ p[2]=v;
+ p[3]=v*r;
+ p[4]=v*v;
+ for(h=1;h<=4;h++){
+  y[BOXCOX+4+h]=(p[h]-1)/(h*0.5);
+  y[BOXCOX+4-h]=(1/p[h]-1)/(-h*0.5);
+ }
+ y[BOXCOX+4]=log(v);
+}
+
+//------------------------------------------------------------------------//
+// This function starts comparing transformations, with '--transforms'.   //
+// It returns false if they cannot be compared for this data.             //
+//------------------------------------------------------------------------//
+
+bool data::start_candidates()
+{
+ if(transformation()!=NOTRANSF){
+  cerr << "Transformations cannot be compared if one is chosen with -t!... Exiting..." << endl;
+  return false;
+ }
+ if(data_files()>1){
+  cerr << "Transformations can only be compared in a single data file!... Exiting..." << endl;
+  return false;
+ }
+ cands = new candidates;
+ cands->ncells=1024;
+ cands->ncombins=0;
+ cands->cells = new candcell*[cands->ncells];
+ memset(cands->cells,0,cands->ncells*sizeof(candcell *));
+ return true;
+}
+
+//------------------------------------------------------------------------//
+// This function adds the value 'val' of an observation with level codes  //
+// 'cline', under all transformations, to the sums of its combination of  //
+// factor levels. The table of combinations is kept at most half full.    //
+//------------------------------------------------------------------------//
+
+void data::add_candidates(LEVCODES cline, double val)
+{
+ candcell **old,*c;
+ double   y[CANDIDATES];
+ int      nold,i,j;
+
+ if(2*(cands->ncombins+1)>cands->ncells){
+  old=cands->cells;
+  nold=cands->ncells;
+  cands->ncells*=2;
+  cands->cells = new candcell*[cands->ncells];
+  memset(cands->cells,0,cands->ncells*sizeof(candcell *));
+  for(i=0;i<nold;i++){
+   if(old[i]){
+    j=hash_codes(old[i]->codes)&(cands->ncells-1);
+    while(cands->cells[j]) j=(j+1)&(cands->ncells-1);
+    cands->cells[j]=old[i];
+   }
+  }
+  delete [] old;
+ }
+ i=hash_codes(cline)&(cands->ncells-1);
+ while((c=cands->cells[i])!=NULL){
+  if(memcmp(cline,c->codes,sizeof(LEVCODES))==0) break;
+  i=(i+1)&(cands->ncells-1);
+ }
+ if(!c){
+  c = new candcell;
+  memset(c,0,sizeof(candcell));
+  memcpy(c->codes,cline,sizeof(LEVCODES));
+  cands->cells[i]=c;
+  cands->ncombins++;
+ }
+ transform_all(transform(val),y);		// Only -p, -t is not allowed
+ for(i=0;i<CANDIDATES;i++){
+  c->sum[i]+=y[i];
+  c->sum2[i]+=y[i]*y[i];
+ }
+ c->n++;
+}
+
+//------------------------------------------------------------------------//
+// This function reports, for each transformation, Cochran's C and        //
+// Bartlett's tests as data::test_homogeneity computes them (combinations //
+// with less replicates count as equalized with their averages) and the   //
+// error mean square. Transformations not defined for some of the         //
+// values, such as logarithms of zero, are reported as such. Box-Cox      //
+// transformations are normalised with the geometric mean of the values.  //
+//------------------------------------------------------------------------//
+
+void data::report_candidates()
+{
+ candcell *c;
+ double   var,sumvar,varmax,b2,ss,ssc,chi,cc,lgm,ms;
+ int      maxreps,df,dfr,nobs,k,i,j;
+ bool     defined;
+ ios      saved(NULL);
+
+ maxreps=nobs=0;
+ lgm=0;
+ for(i=0;i<cands->ncells;i++){
+  c=cands->cells[i];
+  if(!c) continue;
+  if(c->n>maxreps) maxreps=c->n;
+  lgm+=c->sum[BOXCOX+4];		// Logarithms of the values
+  nobs+=c->n;
+ }
+ lgm/=nobs;				// Logarithm of their geometric mean
+ k=cands->ncombins;
+ if(maxreps<2){
+  cout << "There are no replicates to compare transformations" << endl;
+  return;
+ }
+ saved.copyfmt(cout);
+ header(" Transformations ");
+ cout << resetiosflags(ios::right|ios::fixed) << setiosflags(ios::left);
+ cout << setw(14) << "Transformation";
+ cout << resetiosflags(ios::left) << setiosflags(ios::right);
+ cout << setw(10) << "C" << setw(10) << "P";
+ cout << setw(15) << "Chi-square" << setw(10) << "P";
+ cout << setw(15) << "Error MS" << endl;
+ footer();
+ for(j=0;j<CANDIDATES;j++){
+  sumvar=varmax=b2=ss=0;
+  df=dfr=0;
+  defined=true;
+  if((j>=BOXCOX)&&!isfinite(lgm)) defined=false;
+  for(i=0;(i<cands->ncells)&&defined;i++){
+   c=cands->cells[i];
+   if(!c) continue;
+   if(!isfinite(c->sum[j])||!isfinite(c->sum2[j])) defined=false;
+   ssc=c->sum2[j]-pow(c->sum[j],2)/c->n;
+   var=ssc/(maxreps-1);
+   sumvar+=var;
+   if(var>varmax) varmax=var;
+   b2+=(maxreps-1)*log(var);
+   df+=maxreps-1;
+   ss+=ssc;
+   dfr+=c->n-1;
+  }
+  cout << resetiosflags(ios::right) << setiosflags(ios::left);
+  cout << setw(14) << candidate_name[j];
+  cout << resetiosflags(ios::left) << setiosflags(ios::right);
+  if(!defined){
+   cout << "  not defined for some values" << endl;
+   continue;
+  }
+  cc=varmax/sumvar;
+  chi=df*log(sumvar)-b2;
+  ms=(dfr>0)?ss/dfr:0;
+  if(j>=BOXCOX) ms/=exp(2*((j-BOXCOX-4)*0.5-1)*lgm);	// g^(2(lambda-1))
+  cout << setiosflags(ios::fixed) << setprecision(4);
+  cout << setw(10) << cc << setw(10) << cprob(cc,k,maxreps-1);
+  cout << resetiosflags(ios::fixed) << setprecision(6);
+  cout << setw(15) << chi;
+  cout << setiosflags(ios::fixed) << setprecision(4);
+  cout << setw(10) << chiprob(chi,k-1);
+  cout << resetiosflags(ios::fixed) << setprecision(6);
+  cout << setw(15) << ms << endl;
+ }
+ footer();
+ cout << "Error MS of Box-Cox transformations are of values divided by the" << endl;
+ cout << "geometric mean to the power lambda-1, so they can be compared" << endl;
+ cout.copyfmt(saved);
+}
+
+//------------------------------------------------------------------------//
+// This function removes the sums kept to compare transformations         //
+//------------------------------------------------------------------------//
+
+void data::stop_candidates()
+{
+ int i;
+
+ for(i=0;i<cands->ncells;i++) if(cands->cells[i]) delete cands->cells[i];
+ delete [] cands->cells;
+ delete cands;
+ cands=NULL;
+}
+
+#endif
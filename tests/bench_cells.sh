@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Ingestion of data files with more and more cells. Cells used to be kept
+# in a sorted list, searched for each observation, so reading took time
+# proportional to the observations times the cells; with the hash index
+# of cells it should grow with the observations only. Reading alone is
+# timed writing a shard (--shard), which summarizes the data without
+# analysing it; whole runs are timed as well, and, if OLD_MWANOVA is set
+# to a build from before the hash index, whole runs of that build.
+
+. "$(dirname "$0")/timing.sh"
+ROWS=${ROWS:-200000}
+dir=${TMPDIR:-/tmp}/mwanova-bench.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+printf "%-10s %10s %10s %10s %10s\n" "Cells" "Reading" "MB/s" "Run" "Old run"
+for cells in 500 2000 4000 8000 16000; do
+ awk -v rows=$ROWS -v cells=$cells 'BEGIN{
+  srand(13);
+  print "A B C Y";
+  for(i=0;i<rows;i++){
+   c=i%cells;
+   printf "a%d b%d c%d %.4f\n",c%10,int(c/10)%50,int(c/500),100+10*rand();
+  }
+ }' > "$dir/cells.dat" || exit 99
+ r=$(seconds "$MWANOVA" -f "$dir/cells.dat" --shard "$dir/cells.mws")
+ t=$(seconds "$MWANOVA" -f "$dir/cells.dat")
+ if [ -n "$OLD_MWANOVA" ]; then
+  o=$(seconds "$OLD_MWANOVA" -f "$dir/cells.dat")
+ else
+  o="-"
+ fi
+ printf "%-10s %10s %10s %10s %10s\n" $cells $r $(rate "$dir/cells.dat" $r) $t $o
+done
+exit 0
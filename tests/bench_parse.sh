@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Parsing throughput, in MB/s, of a data file with few cells, so that the
+# time taken to analyse it is negligible. Parsing alone is timed writing
+# a shard (--shard), and whole runs are timed as well; if OLD_MWANOVA is
+# set to a build from before the tokenizer (which split lines with strtok
+# and read numbers with atof), its whole runs are timed too.
+
+. "$(dirname "$0")/timing.sh"
+ROWS=${ROWS:-2000000}
+dir=${TMPDIR:-/tmp}/mwanova-bench.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+awk -v rows=$ROWS 'BEGIN{
+ srand(17);
+ print "Site Year Plot Y";
+ for(i=0;i<rows;i++){
+  printf "site%d\t%d\tp%d\t%.6f\n",i%4,2000+int(i/4)%5,int(i/20)%3,1000*rand();
+ }
+}' > "$dir/parse.dat" || exit 99
+
+printf "%-10s %10s %10s %10s\n" "" "Parsing" "Run" "Old run"
+p=$(seconds "$MWANOVA" -f "$dir/parse.dat" --shard "$dir/parse.mws")
+t=$(seconds "$MWANOVA" -f "$dir/parse.dat")
+if [ -n "$OLD_MWANOVA" ]; then
+ o=$(seconds "$OLD_MWANOVA" -f "$dir/parse.dat")
+else
+ o="-"
+fi
+printf "%-10s %10s %10s %10s\n" "Seconds" $p $t $o
+printf "%-10s %10s %10s %10s\n" "MB/s" $(rate "$dir/parse.dat" $p) $(rate "$dir/parse.dat" $t) $(rate "$dir/parse.dat" $o)
+exit 0
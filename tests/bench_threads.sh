@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# Contention of the tables shared by parsing threads: the same number of
+# rows spread uniformly over 400 cells, and skewed so that most of them
+# fall in a few cells (the first ones, with probability falling as a
+# power of the cell number). Each file is read with --threads 1 and with
+# THREADS threads (the number of processors by default).
+
+. "$(dirname "$0")/timing.sh"
+ROWS=${ROWS:-2000000}
+THREADS=${THREADS:-$(nproc 2>/dev/null || echo 4)}
+dir=${TMPDIR:-/tmp}/mwanova-bench.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+for dist in uniform skewed; do
+ awk -v rows=$ROWS -v dist=$dist 'BEGIN{
+  srand(11);
+  print "A B Y";
+  for(i=0;i<rows;i++){
+   u=rand();
+   c=int(((dist=="skewed")?u^6:u)*400);
+   printf "a%d b%d %.4f\n",c%20,int(c/20),100+10*rand();
+  }
+ }' > "$dir/$dist.dat" || exit 99
+done
+
+printf "%-10s %10s %10s %10s %10s\n" "Rows" "1 thread" "MB/s" "$THREADS threads" "MB/s"
+for dist in uniform skewed; do
+ t1=$(seconds "$MWANOVA" -f "$dir/$dist.dat" --threads 1)
+ tn=$(seconds "$MWANOVA" -f "$dir/$dist.dat" --threads $THREADS)
+ printf "%-10s %10s %10s %10s %10s\n" $dist $t1 $(rate "$dir/$dist.dat" $t1) $tn $(rate "$dir/$dist.dat" $tn)
+done
+exit 0
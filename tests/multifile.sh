@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Several data files read together (-f with more than one file) must give
+# the same results as the files concatenated. The design has 6000 cells,
+# many more than the slots the shared tables start with, so the tables
+# are grown while the files are being read.
+
+MWANOVA=${MWANOVA:-../src/mwanova}
+dir=${TMPDIR:-/tmp}/mwanova-multifile.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+awk 'BEGIN{
+ srand(7);
+ for(p=1;p<=3;p++) print "T S* Y" > ("'"$dir"'/part" p ".dat");
+ print "T S* Y" > "'"$dir"'/all.dat";
+ for(r=0;r<3;r++) for(t=0;t<4;t++) for(s=0;s<1500;s++){
+  line=sprintf("t%d s%d %.3f",t,s,10+t+rand());
+  print line > ("'"$dir"'/part" (r+1) ".dat");
+  print line > "'"$dir"'/all.dat";
+ }
+}' || exit 99
+
+"$MWANOVA" -f "$dir/all.dat" > "$dir/all.out" 2>&1 || exit 1
+"$MWANOVA" -f "$dir/part1.dat" "$dir/part2.dat" "$dir/part3.dat" > "$dir/parts.out" 2>&1 || exit 1
+cmp -s "$dir/all.out" "$dir/parts.out" || exit 1
+if gzip -c "$dir/part2.dat" > "$dir/part2.dat.gz" 2>/dev/null; then
+ "$MWANOVA" -f "$dir/part1.dat" "$dir/part2.dat.gz" "$dir/part3.dat" > "$dir/gz.out" 2>&1
+ grep -q "without zlib" "$dir/gz.out" || cmp -s "$dir/all.out" "$dir/gz.out" || exit 1
+fi
+exit 0
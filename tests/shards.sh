@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Shards merged in any order, or through a shard of merged shards, must
+# give the same results. They are only compared among themselves: each
+# shard keeps the sums of its values rounded as they were added, so
+# merged shards may differ from the whole data file in the last digit.
+
+MWANOVA=${MWANOVA:-../src/mwanova}
+dir=${TMPDIR:-/tmp}/mwanova-shards.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+awk 'BEGIN{
+ srand(11);
+ for(p=1;p<=3;p++) print "A B* Y" > ("'"$dir"'/part" p ".dat");
+ for(i=0;i<3000;i++){
+  p=int(rand()*3)+1;
+  printf "a%d b%d %.4f\n",i%3,int(i/3)%7,11+i%3+rand()/3 > ("'"$dir"'/part" p ".dat");
+ }
+}' || exit 99
+
+for p in 1 2 3; do
+ "$MWANOVA" -f "$dir/part$p.dat" --shard "$dir/part$p.mws" > /dev/null 2>&1 || exit 1
+done
+"$MWANOVA" --merge "$dir/part1.mws" "$dir/part2.mws" "$dir/part3.mws" -x > "$dir/123.out" 2>&1 || exit 1
+"$MWANOVA" --merge "$dir/part3.mws" "$dir/part1.mws" "$dir/part2.mws" -x > "$dir/312.out" 2>&1 || exit 1
+"$MWANOVA" --merge "$dir/part2.mws" "$dir/part3.mws" --shard "$dir/part23.mws" > /dev/null 2>&1 || exit 1
+"$MWANOVA" --merge "$dir/part23.mws" "$dir/part1.mws" -x > "$dir/23-1.out" 2>&1 || exit 1
+cmp -s "$dir/123.out" "$dir/312.out" || exit 1
+cmp -s "$dir/123.out" "$dir/23-1.out" || exit 1
+exit 0
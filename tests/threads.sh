@@ -0,0 +1,28 @@
+#!/bin/sh
+#
+# A data file parsed by several threads (--threads) must give exactly the
+# same results as the file read serially (--threads 1). The file is large
+# enough to be split in many chunks, and its values have enough digits
+# that sums rounded in any other order would differ in the output.
+
+MWANOVA=${MWANOVA:-../src/mwanova}
+dir=${TMPDIR:-/tmp}/mwanova-threads.$$
+trap 'rm -rf "$dir"' 0
+mkdir -p "$dir" || exit 99
+
+awk 'BEGIN{
+ srand(9);
+ print "T S Y";
+ for(i=0;i<400000;i++){
+  t=int(rand()*4);
+  s=int(rand()*50);
+  printf "t%d s%d %.6f\n",t,s,1e5+3*t+0.1*s+50*rand();
+ }
+}' > "$dir/med.dat" || exit 99
+
+"$MWANOVA" -f "$dir/med.dat" -x -h --threads 1 > "$dir/serial.out" 2>&1 || exit 1
+for n in 2 3 4 8; do
+ "$MWANOVA" -f "$dir/med.dat" -x -h --threads $n > "$dir/threads.out" 2>&1 || exit 1
+ cmp -s "$dir/serial.out" "$dir/threads.out" || exit 1
+done
+exit 0
@@ -0,0 +1,32 @@
+#
+# Functions used by the benchmarks (bench_*.sh), which are run with
+# 'make bench'. Each benchmark prints a table of wall times; they are
+# not tests, so they never fail because something is slow.
+
+MWANOVA=${MWANOVA:-../src/mwanova}
+REPEAT=${REPEAT:-3}
+
+# Prints the shortest wall time, in seconds, of REPEAT runs of a command,
+# or "-" if it fails
+
+seconds()
+{
+ best=""
+ r=0
+ while [ $r -lt $REPEAT ]; do
+  s=$(date +%s.%N)
+  "$@" > /dev/null 2>&1 || { echo "-"; return; }
+  e=$(date +%s.%N)
+  best=$(echo "$s $e $best" | awk '{t=$2-$1; if(NF==3&&$3<t) t=$3; printf "%.3f",t}')
+  r=$((r+1))
+ done
+ echo "$best"
+}
+
+# Prints the throughput, in MB/s, of reading file $1 in $2 seconds
+
+rate()
+{
+ [ "$2" = "-" ] && { echo "-"; return; }
+ wc -c < "$1" | awk -v t="$2" '{if(t>0) printf "%.1f",$1/1048576/t; else print "-"}'
+}